@@ -30,12 +30,31 @@
 # ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 # POSSIBILITY OF SUCH DAMAGE.
 
+import collections
+import io
 import math
-import sys
-import xml.dom.minidom
+import threading
+import time
+import xml.parsers.expat
 
+import rosgraph_msgs.msg
 import rospy
 import sensor_msgs.msg
+import std_msgs.msg
+import trajectory_msgs.msg
+
+from .arbitration import SourceArbiter, SourceIngest, parse_source_list
+from .description import extract_joints
+from .diagnostics import LoopStatistics
+from .estimator import PositionEstimator
+from .groups import parse_joint_groups
+from .joint_log import JointLogReader, JointLogReplayer, JointLogWriter
+from .joint_store import JointStore, SourceMapping
+from .motion import make_motion_generator
+from .scheduler import monotonic
+from .scheduler import Scheduler
+from .srv import GetJointStates, GetJointStatesResponse
+from .trajectory import Trajectory, TrajectoryPlayer
 
 
 def get_param(name, value=None):
@@ -48,255 +67,998 @@ def get_param(name, value=None):
         return value
 
 
+class ParamSnapshot(object):
+    # An in-memory copy of the parameters, so that looking up a parameter
+    # per joint (such as zeros/<joint>) does not cost a round trip to the
+    # master each.  The private namespace and the list of parameter names
+    # are fetched up front; any other namespace is fetched as a whole the
+    # first time something under it is asked for.  Lookups follow the same
+    # private-then-relative order as get_param().
+    #
+    # With a namespace, the parameters in that namespace come first, then
+    # the private parameters shared with the snapshot base (see
+    # JointStatePublisherHost), and nothing else: a robot does not pick up
+    # the global robot_description, zeros, ... meant for another.
+    def __init__(self, namespace=None, base=None):
+        start = time.time()
+        if base is None:
+            self.private = rospy.get_param('~', {})
+            self.names = set()
+            for name in rospy.get_param_names():
+                # Also record the namespaces, which are valid parameters too.
+                while name and name not in self.names:
+                    self.names.add(name)
+                    name = name.rsplit('/', 1)[0]
+            self.namespaces = {}
+        else:
+            self.private = base.private
+            self.names = base.names
+            self.namespaces = base.namespaces
+        self.namespace = namespace
+        if namespace is None:
+            self.local = {}
+        else:
+            self.local = rospy.get_param(namespace, {})
+        self.fetch_time = time.time() - start
+        rospy.loginfo("Fetched the parameters%s in %.3fs", "" if namespace is None else " of " + namespace,
+                      self.fetch_time)
+
+    @staticmethod
+    def lookup(tree, keys):
+        for key in keys:
+            if not isinstance(tree, dict) or key not in tree:
+                return False, None
+            tree = tree[key]
+        return True, tree
+
+    def get(self, name, value=None):
+        keys = [key for key in name.split('/') if key]
+        found, result = self.lookup(self.local, keys)
+        if found:
+            return result
+        found, result = self.lookup(self.private, keys)
+        if found:
+            return result
+        if self.namespace is not None:
+            return value
+
+        if rospy.resolve_name(name) not in self.names:
+            return value
+        top = keys[0]
+        if top not in self.namespaces:
+            self.namespaces[top] = rospy.get_param(top)
+        found, result = self.lookup(self.namespaces[top], keys[1:])
+        return result if found else value
+
+
+class SerializedResponse(GetJointStatesResponse):
+    # A GetJointStates response that is serialized only once, however many
+    # times it is sent.
+    serialized = None
+
+    def serialize(self, buff):
+        if self.serialized is None:
+            data = io.BytesIO()
+            GetJointStatesResponse.serialize(self, data)
+            self.serialized = data.getvalue()
+        buff.write(self.serialized)
+
+
+class JointTable(object):
+    # Everything that is derived from a robot description: the joints, the
+    # store holding their values, and the message they are published in
+    # along with where each of its entries comes from.  A new description
+    # is built into a table of its own, which then replaces the current one
+    # with a single assignment, so that other threads (such as the
+    # get_joint_states service) never see half of a switch.
+    def __init__(self):
+        self.free_joints = {}
+        self.joint_list = [] # for maintaining the original order of the joints
+        self.dependent_joints = {}
+        self.mimic_table = {}
+        self.store = None
+        self.msg = None
+        self.msg_mapping = []
+        self.msg_slots = []
+        self.msg_index = {}
+        self.msg_deadbands = []
+
+
 class JointStatePublisher():
-    def init_collada(self, robot):
-        robot = robot.getElementsByTagName('kinematics_model')[0].getElementsByTagName('technique_common')[0]
-        for child in robot.childNodes:
-            if child.nodeType is child.TEXT_NODE:
+    def init_collada(self, table, joints):
+        # joints are the ColladaJoints extracted from the description.
+        for child in joints:
+            name = child.name
+            if child.type is None:
+                rospy.logwarn("Unknown joint type %s", name)
+                continue
+            if child.min is None or child.max is None:
+                rospy.logwarn("%s is not fixed, but limits are not specified!" % name)
+                continue
+            minval = child.min
+            maxval = child.max
+            if minval == maxval:  # this is fixed joint
                 continue
-            if child.localName == 'joint':
-                name = child.getAttribute('name')
-                if child.getElementsByTagName('revolute'):
-                    joint = child.getElementsByTagName('revolute')[0]
-                else:
-                    rospy.logwarn("Unknown joint type %s", child)
-                    continue
 
-                if joint:
-                    limit = joint.getElementsByTagName('limits')[0]
-                    minval = float(limit.getElementsByTagName('min')[0].childNodes[0].nodeValue)
-                    maxval = float(limit.getElementsByTagName('max')[0].childNodes[0].nodeValue)
-                if minval == maxval:  # this is fixed joint
-                    continue
+            if child.type == 'revolute':
+                # COLLADA gives angles in degrees
+                minval *= math.pi/180.0
+                maxval *= math.pi/180.0
 
-                self.joint_list.append(name)
-                joint = {'min':minval*math.pi/180.0, 'max':maxval*math.pi/180.0, 'zero':0, 'position':0, 'velocity':0, 'effort':0}
-                self.free_joints[name] = joint
+            table.joint_list.append(name)
+            joint = {'min':minval, 'max':maxval, 'zero':0, 'position':0, 'velocity':0, 'effort':0}
+            table.free_joints[name] = joint
 
-    def init_urdf(self, robot):
-        robot = robot.getElementsByTagName('robot')[0]
+    def init_urdf(self, table, joints):
+        # joints are the UrdfJoints extracted from the description.
         # Find all non-fixed joints
-        for child in robot.childNodes:
-            if child.nodeType is child.TEXT_NODE:
+        for child in joints:
+            jtype = child.type
+            if jtype in ['fixed', 'floating', 'planar']:
                 continue
-            if child.localName == 'joint':
-                jtype = child.getAttribute('type')
-                if jtype in ['fixed', 'floating', 'planar']:
+            name = child.name
+            table.joint_list.append(name)
+            if jtype == 'continuous':
+                minval = -math.pi
+                maxval = math.pi
+            else:
+                try:
+                    minval = float(child.limit['lower'])
+                    maxval = float(child.limit['upper'])
+                except (TypeError, KeyError, ValueError):
+                    rospy.logwarn("%s is not fixed, nor continuous, but limits are not specified!" % name)
                     continue
-                name = child.getAttribute('name')
-                self.joint_list.append(name)
-                if jtype == 'continuous':
-                    minval = -math.pi
-                    maxval = math.pi
+
+            safety_tags = child.safety_controllers
+            if self.use_small and len(safety_tags) == 1:
+                tag = safety_tags[0]
+                if 'soft_lower_limit' in tag:
+                    minval = max(minval, float(tag['soft_lower_limit']))
+                if 'soft_upper_limit' in tag:
+                    maxval = min(maxval, float(tag['soft_upper_limit']))
+
+            mimic_tags = child.mimics
+            if self.use_mimic and len(mimic_tags) == 1:
+                tag = mimic_tags[0]
+                entry = {'parent': tag.get('joint', '')}
+                if 'multiplier' in tag:
+                    entry['factor'] = float(tag['multiplier'])
+                if 'offset' in tag:
+                    entry['offset'] = float(tag['offset'])
+
+                table.dependent_joints[name] = entry
+                continue
+
+            if name in table.dependent_joints:
+                continue
+
+            zeroval = self.get_param("zeros/" + name)
+            if not zeroval:
+                if minval > 0 or maxval < 0:
+                    zeroval = (maxval + minval)/2
                 else:
-                    try:
-                        limit = child.getElementsByTagName('limit')[0]
-                        minval = float(limit.getAttribute('lower'))
-                        maxval = float(limit.getAttribute('upper'))
-                    except:
-                        rospy.logwarn("%s is not fixed, nor continuous, but limits are not specified!" % name)
-                        continue
-
-                safety_tags = child.getElementsByTagName('safety_controller')
-                if self.use_small and len(safety_tags) == 1:
-                    tag = safety_tags[0]
-                    if tag.hasAttribute('soft_lower_limit'):
-                        minval = max(minval, float(tag.getAttribute('soft_lower_limit')))
-                    if tag.hasAttribute('soft_upper_limit'):
-                        maxval = min(maxval, float(tag.getAttribute('soft_upper_limit')))
-
-                mimic_tags = child.getElementsByTagName('mimic')
-                if self.use_mimic and len(mimic_tags) == 1:
-                    tag = mimic_tags[0]
-                    entry = {'parent': tag.getAttribute('joint')}
-                    if tag.hasAttribute('multiplier'):
-                        entry['factor'] = float(tag.getAttribute('multiplier'))
-                    if tag.hasAttribute('offset'):
-                        entry['offset'] = float(tag.getAttribute('offset'))
-
-                    self.dependent_joints[name] = entry
-                    continue
+                    zeroval = 0
 
-                if name in self.dependent_joints:
-                    continue
+            joint = {'min': minval, 'max': maxval, 'zero': zeroval}
+            if self.pub_def_positions:
+                joint['position'] = zeroval
+            if self.pub_def_vels:
+                joint['velocity'] = 0.0
+            if self.pub_def_efforts:
+                joint['effort'] = 0.0
 
-                zeroval = get_param("zeros/" + name)
-                if not zeroval:
-                    if minval > 0 or maxval < 0:
-                        zeroval = (maxval + minval)/2
-                    else:
-                        zeroval = 0
-
-                joint = {'min': minval, 'max': maxval, 'zero': zeroval}
-                if self.pub_def_positions:
-                    joint['position'] = zeroval
-                if self.pub_def_vels:
-                    joint['velocity'] = 0.0
-                if self.pub_def_efforts:
-                    joint['effort'] = 0.0
-
-                if jtype == 'continuous':
-                    joint['continuous'] = True
-                self.free_joints[name] = joint
+            if jtype == 'continuous':
+                joint['continuous'] = True
+            table.free_joints[name] = joint
 
-    def __init__(self):
-        description = get_param('robot_description')
+    def get_param(self, name, value=None):
+        return self.params.get(name, value)
+
+    def __init__(self, namespace=None, params=None):
+        # With a namespace, the parameters and topics of this publisher live
+        # in it, so that one process can serve several robots.
+        self.namespace = namespace
+        if params is None:
+            params = ParamSnapshot(namespace)
+        self.params = params
+
+        description = self.get_param('robot_description')
         if description is None:
             raise RuntimeError('The robot_description parameter is required and not set.')
 
-        self.free_joints = {}
-        self.joint_list = [] # for maintaining the original order of the joints
-        self.dependent_joints = get_param("dependent_joints", {})
-        self.use_mimic = get_param('use_mimic_tags', True)
-        self.use_small = get_param('use_smallest_joint_limits', True)
+        self.use_mimic = self.get_param('use_mimic_tags', True)
+        self.use_small = self.get_param('use_smallest_joint_limits', True)
 
 
-        self.pub_def_positions = get_param("publish_default_positions", True)
-        self.pub_def_vels = get_param("publish_default_velocities", False)
-        self.pub_def_efforts = get_param("publish_default_efforts", False)
+        self.pub_def_positions = self.get_param("publish_default_positions", True)
+        self.pub_def_vels = self.get_param("publish_default_velocities", False)
+        self.pub_def_efforts = self.get_param("publish_default_efforts", False)
 
-        robot = xml.dom.minidom.parseString(description)
-        if robot.getElementsByTagName('COLLADA'):
-            self.init_collada(robot)
-        else:
-            self.init_urdf(robot)
+        # In publish_on_change mode, messages are only sent when a value moved
+        # by more than its joint's deadband, or at heartbeat_rate otherwise.
+        self.publish_on_change = self.get_param("publish_on_change", False)
+        self.deadband = self.get_param("deadband", 0.0)
+        self.deadbands = self.get_param("deadbands", {})
+        self.heartbeat_period = 1.0 / self.get_param("heartbeat_rate", 1.0)
+        self.last_published = None
+        self.last_publish_time = None
+
+        # Groups of joints that are also published on topics of their own.
+        # The combined joint_states topic can then be turned off.
+        self.groups = parse_joint_groups(self.get_param("joint_groups", {}), self.resolve)
+        self.publish_combined = self.get_param("publish_combined", True)
+
+        # Stream through the description rather than building a DOM of it,
+        # or load what was extracted from it last time.
+        self.description_cache_dir = self.get_param("description_cache_dir", "")
+        self.use_table(self.build_table(*extract_joints(description, self.description_cache_dir)))
+
+        # The robot description can be swapped at runtime, either by
+        # publishing it on description_topic or by changing the parameter
+        # when watch_robot_description is set.  The new description is parsed
+        # by whoever notices the change, and the publish loop then switches
+        # to it in between two messages.  The parsed joints are handed over
+        # in a deque with a single slot, which is swapped atomically, so a
+        # description that arrives while the previous one is being switched
+        # to is not lost.
+        self.description = description
+        self.pending_joints = collections.deque(maxlen=1)
+        description_topic = self.get_param("description_topic", "")
+        if description_topic:
+            self.description_sub = rospy.Subscriber(self.resolve(description_topic), std_msgs.msg.String,
+                                                    self.description_cb)
+        if self.get_param("watch_robot_description", False):
+            if 'robot_description' in self.params.local or 'robot_description' not in self.params.private:
+                self.description_param = self.resolve('robot_description')
+            else:
+                self.description_param = '~robot_description'
+            self.description_timer = rospy.Timer(rospy.Duration(0.5), self.poll_description)
 
         # The source_update_cb will be called at the end of self.source_cb.
         # The main purpose it to allow external observes (such as the
         # joint_state_publisher_gui) to be notified when things are updated.
         self.source_update_cb = None
+        # The reload_cb is called after switching to a new robot description,
+        # from the publish loop, so that observers holding on to the joints
+        # (such as the sliders of joint_state_publisher_gui) can rebuild.
+        self.reload_cb = None
+
+        # In publish_on_update mode, source updates wake the publish loop up
+        # right away instead of waiting for the next cycle of the rate.
+        self.publish_on_update = self.get_param("publish_on_update", False)
+        self.publish_event = threading.Event()
+        rospy.on_shutdown(self.publish_event.set)
+
+        # In lockstep mode, exactly one message is published for every
+        # lockstep_ticks messages on /clock ('clock'), or for every source
+        # message ('source'), stamped with the time of that tick or message.
+        # The steps are queued, so that none is lost or doubled however far
+        # ahead of real time the simulation runs.
+        self.lockstep = self.get_param("lockstep", "")
+        if self.lockstep not in ('', 'clock', 'source'):
+            raise ValueError("Unknown lockstep mode '%s'" % self.lockstep)
+        self.lockstep_ticks = int(self.get_param("lockstep_ticks", 1))
+        if self.lockstep_ticks < 1:
+            raise ValueError("lockstep_ticks must be at least 1, not %d" % self.lockstep_ticks)
+        self.lockstep_steps = collections.deque()
+        self.lockstep_ready = threading.Condition()
+        self.clock_count = 0
+        if self.lockstep == 'clock':
+            self.clock_sub = rospy.Subscriber('/clock', rosgraph_msgs.msg.Clock, self.clock_cb)
+
+        # Timings of the publish loop, published on the diagnostics topic
+        # when diagnostics_rate is set.
+        diagnostics_rate = self.get_param("diagnostics_rate", 0.0)
+        if diagnostics_rate > 0:
+            self.stats = LoopStatistics(diagnostics_rate, monotonic, namespace)
+        else:
+            self.stats = None
+        self.scheduler = None
+        self.newest_source_stamp = None
+
+        source_list = self.get_param("source_list", [])
+        self.source_configs = parse_source_list(source_list)
+        # Instead of sweeping every joint by delta each cycle, the joints can
+        # be moved by one of the patterns of a motion generator.
+        motion = self.get_param("motion", None)
+        self.motion = None if motion is None else make_motion_generator(motion)
 
-        source_list = get_param("source_list", [])
+        # Positions from sources can be estimated at the time of publishing,
+        # to make up for the latency between the source and us.
+        self.estimate_positions = self.get_param("estimate_positions", False)
+        self.max_extrapolation = self.get_param("max_extrapolation", 0.1)
+        self.estimated_joints = self.get_param("estimated_joints", None)
+        self.estimator = self.make_estimator()
+
+        # Sources given with a priority or timeout are arbitrated joint by
+        # joint; otherwise the last message to arrive wins.
+        if any(source.priority != 0 or source.timeout > 0 for source in self.source_configs):
+            self.arbiter = SourceArbiter(self.store, self.source_configs)
+        else:
+            self.arbiter = None
         self.sources = []
-        for source in source_list:
-            self.sources.append(rospy.Subscriber(source, sensor_msgs.msg.JointState, self.source_cb))
+        self.source_mappings = {}
+        self.ingests = [SourceIngest(source) for source in self.source_configs]
+        self.coalesced_sources = [index for index, ingest in enumerate(self.ingests) if ingest.coalesce]
+        for index, source in enumerate(self.source_configs):
+            self.sources.append(rospy.Subscriber(self.resolve(source.topic), sensor_msgs.msg.JointState,
+                                                 self.source_cb, callback_args=index,
+                                                 queue_size=source.queue_size, tcp_nodelay=source.tcp_nodelay))
+            if self.stats is not None:
+                self.stats.add_source(source.topic, self.ingests[index])
+
+        # Trajectories received on trajectory_topic, or read from
+        # trajectory_file, are played back as one more source.
+        self.player = TrajectoryPlayer()
+        self.trajectory_mapping = None
+        trajectory_topic = self.get_param("trajectory_topic", "")
+        if trajectory_topic:
+            self.trajectory_sub = rospy.Subscriber(self.resolve(trajectory_topic),
+                                                   trajectory_msgs.msg.JointTrajectory, self.trajectory_cb)
+        trajectory_file = self.get_param("trajectory_file", "")
+        if trajectory_file:
+            with open(trajectory_file) as f:
+                trajectory = Trajectory.from_yaml(f)
+            # Started by the first publish cycle rather than now, which may
+            # be before the first /clock message.
+            self.play_trajectory(trajectory, None, self.get_param("trajectory_loop", False))
+
+        # A joint log recorded earlier (see record_file) can be replayed as
+        # one more source.
+        self.replayer = None
+        self.replay_mapping = None
+        replay_file = self.get_param("replay_file", "")
+        if replay_file:
+            self.replayer = JointLogReplayer(JointLogReader(replay_file), self.get_param("replay_rate", 1.0),
+                                             self.get_param("replay_loop", False))
+
+        self.pub = rospy.Publisher(self.resolve('joint_states'), sensor_msgs.msg.JointState, queue_size=5)
+
+        # The current joint states can also be asked for, which is cheaper
+        # than a high rate for consumers that only need them now and then.
+        # Responses are kept until the joints change.
+        self.query_cache = {}
+        if self.get_param("query_service", False):
+            self.query_srv = rospy.Service(self.resolve('get_joint_states'), GetJointStates,
+                                           self.get_joint_states_cb)
+
+        # Everything published can be recorded to a compact joint log.
+        self.recorder = None
+        record_file = self.get_param("record_file", "")
+        if record_file:
+            self.recorder = JointLogWriter(record_file)
+            # The publish loop may still be writing; the file is closed when
+            # the process exits.
+            rospy.on_shutdown(self.recorder.flush)
+
+    def resolve(self, name):
+        # Put relative topic and parameter names into our namespace, if any.
+        if self.namespace is None or name.startswith('/') or name.startswith('~'):
+            return name
+        return self.namespace.rstrip('/') + '/' + name
+
+    def build_table(self, kind, joints):
+        # Build the joint table from the joints extracted from a description.
+        table = JointTable()
+        # Copied, since the mimic joints of the description get added to it.
+        table.dependent_joints = dict(self.get_param("dependent_joints", {}))
+        if kind == 'collada':
+            self.init_collada(table, joints)
+        else:
+            self.init_urdf(table, joints)
+
+        self.compile_mimic_table(table)
+
+        # From here on the joint values live in contiguous arrays; the
+        # free_joints dictionary is replaced by lightweight views onto them.
+        table.store = JointStore([(name, table.free_joints[name]) for name in table.joint_list
+                                  if name in table.free_joints])
+        table.free_joints = table.store.joints
+
+        self.init_msg(table)
+        return table
+
+    def use_table(self, table):
+        # Switch to table.  Code that may run outside the publish loop reads
+        # it through self.table only; the publish loop, which is the one
+        # switching, and observers such as joint_state_publisher_gui also
+        # find its parts as attributes of their own.
+        self.table = table
+        self.joint_list = table.joint_list
+        self.free_joints = table.free_joints
+        self.dependent_joints = table.dependent_joints
+        self.mimic_table = table.mimic_table
+        self.store = table.store
+        self.msg = table.msg
+        self.msg_mapping = table.msg_mapping
+        self.msg_slots = table.msg_slots
+        self.msg_index = table.msg_index
+        self.msg_deadbands = table.msg_deadbands
+        for group in self.groups:
+            group.bind(table.msg.name)
+
+        # Which of position, velocity and effort get published is decided
+        # lazily at the start of loop(), since the GUI may fill in positions
+        # after construction, and redone whenever a joint gains a field.
+        self.msg_layout_version = None
+
+    def make_estimator(self):
+        if not self.estimate_positions:
+            return None
+        return PositionEstimator(self.store, self.max_extrapolation, self.estimated_joints)
+
+    def description_cb(self, msg):
+        self.queue_description(msg.data)
+
+    def poll_description(self, event):
+        # get_param_cached() subscribes to updates of the parameter, so this
+        # does not go to the master every time.
+        try:
+            description = rospy.get_param_cached(self.description_param)
+        except KeyError:
+            return
+        self.queue_description(description)
 
-        self.pub = rospy.Publisher('joint_states', sensor_msgs.msg.JointState, queue_size=5)
+    def queue_description(self, description):
+        if description == self.description:
+            return
+        self.description = description
+        try:
+            self.pending_joints.append(extract_joints(description, self.description_cache_dir))
+        except (xml.parsers.expat.ExpatError, ValueError) as e:
+            rospy.logerr("Ignoring the new robot description, it could not be parsed: %s", e)
+            return
+        self.request_publish()
 
-    def source_cb(self, msg):
-        for i in range(len(msg.name)):
-            name = msg.name[i]
-            if name not in self.free_joints:
+    def apply_pending_joints(self):
+        # Switch to the joints of a new description, keeping the values of
+        # the joints that are still there.  Runs in the publish loop, so that
+        # the table never changes under a message being built.
+        try:
+            kind, joints = self.pending_joints.popleft()
+        except IndexError:
+            return
+        try:
+            table = self.build_table(kind, joints)
+        except (RuntimeError, ValueError) as e:
+            rospy.logerr("Ignoring the new robot description: %s", e)
+            return
+
+        old_store = self.table.store
+        if (table.joint_list == self.table.joint_list and table.mimic_table == self.table.mimic_table and
+                table.store.same_joints(old_store)):
+            # Nothing that matters to us changed; keep the current table.
+            return
+
+        kept = table.store.copy_values_from(old_store)
+        self.use_table(table)
+        if self.arbiter is not None:
+            self.arbiter = SourceArbiter(self.store, self.source_configs)
+        self.estimator = self.make_estimator()
+        self.last_published = None
+        rospy.loginfo("Switched to the new robot description: %d joints kept, %d added, %d removed",
+                      kept, len(self.store) - kept, len(old_store) - kept)
+        if self.reload_cb is not None:
+            self.reload_cb()
+
+    def compile_mimic_table(self, table):
+        # Resolve every published dependent joint to the free joint at the
+        # root of its mimic chain, composing the factors and offsets along the
+        # way, so that the publish loop does not have to walk the chain on
+        # every cycle.
+        table.mimic_table = {}
+        for name in table.joint_list:
+            if name in table.free_joints or name not in table.dependent_joints:
                 continue
+            param = table.dependent_joints[name]
+            parent = param['parent']
+            factor = param.get('factor', 1)
+            offset = param.get('offset', 0)
+            # Handle recursive mimic chain
+            recursive_mimic_chain_joints = [name]
+            while parent in table.dependent_joints:
+                if parent in recursive_mimic_chain_joints:
+                    error_message = "Found an infinite recursive mimic chain"
+                    rospy.logerr("%s: [%s, %s]", error_message, ', '.join(recursive_mimic_chain_joints), parent)
+                    raise RuntimeError(error_message)
+                recursive_mimic_chain_joints.append(parent)
+                param = table.dependent_joints[parent]
+                parent = param['parent']
+                offset += factor * param.get('offset', 0)
+                factor *= param.get('factor', 1)
+            if parent not in table.free_joints:
+                raise RuntimeError("Joint %s mimics %s, which is not a movable joint." % (name, parent))
+            table.mimic_table[name] = (parent, factor, offset)
 
-            if msg.position:
-                position = msg.position[i]
+    def init_msg(self, table):
+        # The joint set only changes with the description, so the published
+        # message is allocated once and every cycle of loop() only overwrites
+        # the numeric values.  msg_mapping holds the (store slot, factor,
+        # offset) that feeds each entry of the message.
+        table.msg = sensor_msgs.msg.JointState()
+        store = table.store
+        for name in table.joint_list:
+            if name in table.free_joints:
+                entry = (store.slots[name], 1.0, 0.0)
+            elif name in table.mimic_table:
+                parent, factor, offset = table.mimic_table[name]
+                entry = (store.slots[parent], factor, offset)
             else:
-                position = None
-            if msg.velocity:
-                velocity = msg.velocity[i]
+                # A joint whose limits could not be parsed.
+                continue
+            table.msg.name.append(str(name))
+            table.msg_mapping.append(entry)
+        table.msg_slots = [slot for slot, factor, offset in table.msg_mapping]
+        table.msg_index = dict((name, i) for i, name in enumerate(table.msg.name))
+        table.msg_deadbands = [float(self.deadbands.get(name, self.deadband)) for name in table.msg.name]
+
+    def msg_fields(self, table):
+        # Whether position, velocity and effort get published.
+        store = table.store
+        return (len(table.mimic_table) > 0 or store.any_present('position'),
+                store.any_present('velocity'), store.any_present('effort'))
+
+    def update_msg_layout(self):
+        store = self.store
+        has_position, has_velocity, has_effort = self.msg_fields(self.table)
+
+        num_joints = len(self.msg.name)
+        self.msg.position = num_joints * [0.0] if has_position else []
+        self.msg.velocity = num_joints * [0.0] if has_velocity else []
+        self.msg.effort = num_joints * [0.0] if has_effort else []
+        for group in self.groups:
+            group.update_layout(self.msg)
+        self.msg_layout_version = store.layout_version
+
+    def source_cb(self, msg, source=None):
+        if self.lockstep == 'source' and source is not None:
+            # The message is taken in by the publish loop, right before the
+            # message of its step is built.
+            self.ingests[source].count(msg)
+            if msg.header.stamp.is_zero():
+                self.queue_step(rospy.Time.now(), msg, source)
             else:
-                velocity = None
-            if msg.effort:
-                effort = msg.effort[i]
+                self.queue_step(msg.header.stamp, msg, source)
+            return
+        if source is not None:
+            ingest = self.ingests[source]
+            ingest.count(msg)
+            if ingest.coalesce:
+                # Only the latest message is kept, and taken in by the
+                # publish loop right before it builds the next message.
+                ingest.push(msg)
+                self.request_publish()
+                return
+        self.take_source_msg(msg, source)
+        self.request_publish()
+
+    def take_source_msg(self, msg, source):
+        # Each source keeps the mapping of its last message's names onto the
+        # joint store, which is rebuilt only when the names (or the store,
+        # after a description reload) change.
+        arbiter = self.arbiter
+        if arbiter is not None and source is not None:
+            store = arbiter.store
+        else:
+            arbiter = None
+            store = self.store
+        estimator = self.estimator
+        if estimator is not None and not msg.position:
+            estimator = None
+        mapping = self.source_mappings.get(source)
+        if mapping is None or not mapping.matches(store, msg.name):
+            mapping = SourceMapping(store, msg.name)
+            self.source_mappings[source] = mapping
+
+        # All values of a message are written as one, so that a published
+        # message never holds half of it.
+        if arbiter is not None or estimator is not None:
+            now = rospy.get_time()
+            if msg.header.stamp.is_zero():
+                stamp = now
             else:
-                effort = None
+                stamp = msg.header.stamp.to_sec()
+        store.begin_write()
+        try:
+            if arbiter is not None:
+                fields = [(field, values) for field, values in
+                          (('position', msg.position), ('velocity', msg.velocity), ('effort', msg.effort))
+                          if values]
+                arbiter.apply(source, mapping, fields, stamp, now)
+            else:
+                if msg.position:
+                    mapping.scatter('position', msg.position)
+                if msg.velocity:
+                    mapping.scatter('velocity', msg.velocity)
+                if msg.effort:
+                    mapping.scatter('effort', msg.effort)
+            if estimator is not None:
+                if arbiter is not None:
+                    estimator.record(mapping, stamp, msg.position, msg.velocity, arbiter.owner, source)
+                else:
+                    estimator.record(mapping, stamp, msg.position, msg.velocity)
+        finally:
+            store.end_write()
 
-            joint = self.free_joints[name]
-            if position is not None:
-                joint['position'] = position
-            if velocity is not None:
-                joint['velocity'] = velocity
-            if effort is not None:
-                joint['effort'] = effort
+        if self.stats is not None:
+            if msg.header.stamp.is_zero():
+                self.newest_source_stamp = rospy.get_time()
+            else:
+                self.newest_source_stamp = msg.header.stamp.to_sec()
 
         if self.source_update_cb is not None:
             self.source_update_cb()
 
+    def trajectory_cb(self, msg):
+        try:
+            trajectory = Trajectory.from_msg(msg)
+        except ValueError as e:
+            rospy.logerr("Ignoring trajectory: %s", e)
+            return
+        if msg.header.stamp.is_zero():
+            start = rospy.get_time()
+        else:
+            start = msg.header.stamp.to_sec()
+        self.play_trajectory(trajectory, start)
+
+    def play_trajectory(self, trajectory, start, loop=False):
+        # Like a trajectory controller, start out from where the joints are
+        # if the first point is not at time 0.
+        store = self.store
+        positions = []
+        for name in trajectory.joint_names:
+            slot = store.slots.get(name)
+            positions.append(0.0 if slot is None else store.position[slot])
+        trajectory.prepend(positions)
+        self.player.play(trajectory, start, loop)
+        self.request_publish()
+
+    def play_trajectory_step(self):
+        # Write the joints of the playing trajectory, as of now, to the store.
+        sample = self.player.sample(rospy.get_time())
+        if sample is None:
+            return
+        trajectory, positions, velocities = sample
+        store = self.store
+        mapping = self.trajectory_mapping
+        if mapping is None or not mapping.matches(store, trajectory.joint_names):
+            mapping = SourceMapping(store, trajectory.joint_names)
+            self.trajectory_mapping = mapping
+        store.begin_write()
+        try:
+            mapping.scatter('position', positions)
+            mapping.scatter('velocity', velocities)
+        finally:
+            store.end_write()
+
+    def replay_step(self):
+        # Write the joints of the frame of the replayed log that is due, if
+        # any, to the store.
+        sample = self.replayer.sample(rospy.get_time())
+        if sample is None:
+            return
+        stamp, names, frame = sample
+        store = self.store
+        mapping = self.replay_mapping
+        if mapping is None or not mapping.matches(store, names):
+            mapping = SourceMapping(store, names)
+            self.replay_mapping = mapping
+        store.begin_write()
+        try:
+            for field, values in frame.items():
+                mapping.scatter(field, values)
+        finally:
+            store.end_write()
+
+    def clock_cb(self, msg):
+        self.clock_count += 1
+        if self.clock_count % self.lockstep_ticks == 0:
+            self.queue_step(msg.clock)
+
+    def queue_step(self, stamp, msg=None, source=None):
+        with self.lockstep_ready:
+            self.lockstep_steps.append((stamp, msg, source))
+            self.lockstep_ready.notify()
+
     def set_source_update_cb(self, user_cb):
         self.source_update_cb = user_cb
 
+    def set_reload_cb(self, user_cb):
+        self.reload_cb = user_cb
+
+    def request_publish(self):
+        # Let the publish loop know that joint values changed.  This only has
+        # an effect in publish_on_update mode.
+        if self.publish_on_update:
+            self.publish_event.set()
+
     def loop(self):
-        hz = get_param("rate", 10)  # 10hz
-        r = rospy.Rate(hz)
+        delta = self.get_param("delta", 0.0)
+
+        if self.lockstep:
+            self.lockstep_loop(delta)
+            return
+
+        if self.publish_on_update:
+            self.event_loop(delta)
+            return
 
-        delta = get_param("delta", 0.0)
+        hz = self.get_param("rate", 10)  # 10hz
+        policy = self.get_param("deadline_policy", "skip")
+        if rospy.rostime.is_wallclock():
+            self.scheduler = Scheduler(hz, policy)
+        else:
+            self.scheduler = Scheduler.for_ros_time(hz, policy)
 
         # Publish Joint States
+        missed = 0
+        stats = self.stats
+        self.scheduler.start()
         while not rospy.is_shutdown():
-            msg = sensor_msgs.msg.JointState()
-            msg.header.stamp = rospy.Time.now()
-
-            if delta > 0:
-                self.update(delta)
-
-            # Initialize msg.position, msg.velocity, and msg.effort.
-            has_position = len(self.dependent_joints.items()) > 0
-            has_velocity = False
-            has_effort = False
-            for name, joint in self.free_joints.items():
-                if not has_position and 'position' in joint:
-                    has_position = True
-                if not has_velocity and 'velocity' in joint:
-                    has_velocity = True
-                if not has_effort and 'effort' in joint:
-                    has_effort = True
-            num_joints = (len(self.free_joints.items()) +
-                          len(self.dependent_joints.items()))
-            if has_position:
-                msg.position = num_joints * [0.0]
-            if has_velocity:
-                msg.velocity = num_joints * [0.0]
-            if has_effort:
-                msg.effort = num_joints * [0.0]
-
-            for i, name in enumerate(self.joint_list):
-                msg.name.append(str(name))
-                joint = None
-
-                # Add Free Joint
-                if name in self.free_joints:
-                    joint = self.free_joints[name]
-                    factor = 1
-                    offset = 0
-                # Add Dependent Joint
-                elif name in self.dependent_joints:
-                    param = self.dependent_joints[name]
-                    parent = param['parent']
-                    factor = param.get('factor', 1)
-                    offset = param.get('offset', 0)
-                    # Handle recursive mimic chain
-                    recursive_mimic_chain_joints = [name]
-                    while parent in self.dependent_joints:
-                        if parent in recursive_mimic_chain_joints:
-                            error_message = "Found an infinite recursive mimic chain"
-                            rospy.logerr("%s: [%s, %s]", error_message, ', '.join(recursive_mimic_chain_joints), parent)
-                            sys.exit(1)
-                        recursive_mimic_chain_joints.append(parent)
-                        param = self.dependent_joints[parent]
-                        parent = param['parent']
-                        offset += factor * param.get('offset', 0)
-                        factor *= param.get('factor', 1)
-                    joint = self.free_joints[parent]
-
-                if has_position and 'position' in joint:
-                    msg.position[i] = joint['position'] * factor + offset
-                if has_velocity and 'velocity' in joint:
-                    msg.velocity[i] = joint['velocity'] * factor
-                if has_effort and 'effort' in joint:
-                    msg.effort[i] = joint['effort']
-
-            if msg.name or msg.position or msg.velocity or msg.effort:
-                # Only publish non-empty messages
-                self.pub.publish(msg)
-            try:
-                r.sleep()
-            except rospy.exceptions.ROSTimeMovedBackwardsException:
-                pass
+            if delta > 0 or self.motion is not None:
+                self.timed_update(delta)
 
-    def update(self, delta):
-        for name, joint in self.free_joints.iteritems():
-            forward = joint.get('forward', True)
-            if forward:
-                joint['position'] += delta
-                if joint['position'] > joint['max']:
-                    if joint.get('continuous', False):
-                        joint['position'] = joint['min']
-                    else:
-                        joint['position'] = joint['max']
-                        joint['forward'] = not forward
+            self.publish_joint_states()
+
+            if stats is not None:
+                start = monotonic()
+                self.scheduler.sleep()
+                now = monotonic()
+                stats.record('sleep', now - start)
+                stats.report(now, self.scheduler)
             else:
-                joint['position'] -= delta
-                if joint['position'] < joint['min']:
-                    joint['position'] = joint['min']
-                    joint['forward'] = not forward
+                self.scheduler.sleep()
+            if self.scheduler.missed != missed:
+                missed = self.scheduler.missed
+                rospy.logwarn_throttle(10.0, "Publishing can not keep up with a rate of %s Hz; "
+                                       "%d deadlines missed so far" % (hz, missed))
+
+    def lockstep_loop(self, delta):
+        # Publish one message per queued step, in order.
+        steps = self.lockstep_steps
+        while not rospy.is_shutdown():
+            with self.lockstep_ready:
+                while not steps and not rospy.is_shutdown():
+                    # Keep reporting while the simulation is paused.
+                    if self.stats is not None:
+                        self.stats.report(monotonic())
+                    self.lockstep_ready.wait(0.1)
+                if not steps:
+                    break
+                step = steps.popleft()
+
+            self.lockstep_step(delta, *step)
+            if self.stats is not None:
+                self.stats.report(monotonic())
+
+    def drain_lockstep(self, delta):
+        # Publish the steps queued so far, for callers that run their own
+        # loop rather than lockstep_loop().
+        steps = self.lockstep_steps
+        while True:
+            with self.lockstep_ready:
+                if not steps:
+                    return
+                step = steps.popleft()
+            self.lockstep_step(delta, *step)
+
+    def lockstep_step(self, delta, stamp, msg, source):
+        if msg is not None:
+            self.take_source_msg(msg, source)
+        if delta > 0 or self.motion is not None:
+            self.timed_update(delta)
+        self.publish_joint_states(stamp)
+
+    def event_loop(self, delta):
+        # Publish as soon as a source update comes in, but no more often than
+        # min_publish_interval so that bursts get coalesced into a single
+        # message.  When nothing changes, keep publishing at heartbeat_rate.
+        min_interval = self.get_param("min_publish_interval", 0.0)
+        heartbeat = self.heartbeat_period
+
+        last_publish = None
+        next_heartbeat = None
+        while not rospy.is_shutdown():
+            if self.stats is not None:
+                self.stats.report(monotonic())
+            if next_heartbeat is not None:
+                start = monotonic()
+                if last_publish is not None:
+                    remaining = last_publish + min_interval - monotonic()
+                    if remaining > 0:
+                        time.sleep(remaining)
+                remaining = next_heartbeat - monotonic()
+                if remaining > 0:
+                    self.publish_event.wait(remaining)
+                if rospy.is_shutdown():
+                    break
+                if self.stats is not None:
+                    self.stats.record('sleep', monotonic() - start)
+            self.publish_event.clear()
+
+            if delta > 0 or self.motion is not None:
+                self.timed_update(delta)
+
+            if self.publish_joint_states():
+                last_publish = monotonic()
+                next_heartbeat = last_publish + heartbeat
+            elif next_heartbeat is None or next_heartbeat <= monotonic():
+                # Nothing to publish at all, as with a robot without joints;
+                # still wait for the next heartbeat rather than spinning.
+                next_heartbeat = monotonic() + heartbeat
+
+    def timed_update(self, delta):
+        if self.stats is None:
+            self.update(delta)
+            return
+        start = monotonic()
+        self.update(delta)
+        self.stats.record('update', monotonic() - start)
+
+    def publish_joint_states(self, stamp=None):
+        # Returns whether a message was actually published.  The message is
+        # stamped with stamp, or the current time if not given.
+        stats = self.stats
+        if stats is not None:
+            start = monotonic()
+
+        if self.pending_joints:
+            self.apply_pending_joints()
+
+        if self.player.playing is not None:
+            self.play_trajectory_step()
+        if self.replayer is not None:
+            self.replay_step()
+
+        for index in self.coalesced_sources:
+            msg = self.ingests[index].pop()
+            if msg is not None:
+                self.take_source_msg(msg, index)
+
+        arbiter = self.arbiter
+        if arbiter is not None:
+            deadline = arbiter.next_deadline()
+            if deadline is not None:
+                now = rospy.get_time()
+                if deadline <= now:
+                    arbiter.store.begin_write()
+                    try:
+                        arbiter.expire(now)
+                    finally:
+                        arbiter.store.end_write()
+
+        layout_changed = self.msg_layout_version != self.store.layout_version
+        if layout_changed:
+            self.update_msg_layout()
+
+        msg = self.msg
+        if not msg.name:
+            # Only publish non-empty messages
+            return False
+
+        # Evaluate the free and mimic joints from a consistent snapshot of the
+        # store, without blocking the source callbacks.
+        if stamp is None:
+            stamp = rospy.Time.now()
+        self.store.read_consistent(self.fill_msg, (stamp,))
+
+        if self.publish_on_change:
+            now = monotonic()
+            if (not layout_changed and self.last_published is not None and
+                    now - self.last_publish_time < self.heartbeat_period and
+                    not self.joint_states_changed()):
+                if stats is not None:
+                    stats.record('build', monotonic() - start)
+                return False
+            self.last_published = (list(msg.position), list(msg.velocity), list(msg.effort))
+            self.last_publish_time = now
+
+        msg.header.stamp = stamp
+        if stats is None:
+            self.publish_msg(msg)
+            return True
+
+        built = monotonic()
+        self.publish_msg(msg)
+        published = monotonic()
+        stats.record('build', built - start)
+        stats.record('publish', published - built)
+        stats.record_publish(published)
+        if self.newest_source_stamp is not None:
+            stats.record('source_age', msg.header.stamp.to_sec() - self.newest_source_stamp)
+        return True
+
+    def publish_msg(self, msg):
+        if self.publish_combined:
+            self.pub.publish(msg)
+        if self.groups:
+            now = monotonic()
+            for group in self.groups:
+                if group.due(now):
+                    group.publish(msg)
+        if self.recorder is not None:
+            self.recorder.write(msg)
+
+    def fill_msg(self, stamp):
+        if self.estimator is not None:
+            self.fill_values(self.store, self.msg, self.msg_mapping, self.msg_slots, stamp.to_sec())
+        else:
+            self.fill_values(self.store, self.msg, self.msg_mapping, self.msg_slots)
+
+    def fill_values(self, store, msg, mapping, slots, estimate_time=None):
+        # Evaluate the free and mimic joints as one pass over the store.
+        # mapping holds the (slot, factor, offset) of each entry of msg, and
+        # slots just the slots.
+        if msg.position:
+            position = store.position
+            if estimate_time is not None:
+                position = self.estimator.estimate(position, estimate_time)
+            if store.all_present('position'):
+                msg.position[:] = [position[slot] * factor + offset
+                                   for slot, factor, offset in mapping]
+            else:
+                present = store.present['position']
+                msg.position[:] = [position[slot] * factor + offset if present[slot] else 0.0
+                                   for slot, factor, offset in mapping]
+        # Absent velocities and efforts read as 0.0 from the store.
+        if msg.velocity:
+            velocity = store.velocity
+            msg.velocity[:] = [velocity[slot] * factor for slot, factor, offset in mapping]
+        if msg.effort:
+            effort = store.effort
+            msg.effort[:] = [effort[slot] for slot in slots]
+
+    def get_joint_states_cb(self, req):
+        # Answer from a consistent snapshot of the store.  The response for
+        # a set of names is reused, serialization included, for as long as
+        # the store is not written to.
+        table = self.table
+        store = table.store
+        names = tuple(req.names)
+        version = (store, store.sequence, store.layout_version)
+        cached = self.query_cache.get(names)
+        if cached is not None and cached[0] == version:
+            return cached[1]
+
+        if names:
+            indices = [table.msg_index[name] for name in names if name in table.msg_index]
+            mapping = [table.msg_mapping[i] for i in indices]
+            state_names = [table.msg.name[i] for i in indices]
+        else:
+            mapping = table.msg_mapping
+            state_names = list(table.msg.name)
+        slots = [slot for slot, factor, offset in mapping]
+
+        response = SerializedResponse()
+        state = response.state
+        state.name = state_names
+        has_position, has_velocity, has_effort = self.msg_fields(table)
+        state.position = len(mapping) * [0.0] if has_position else []
+        state.velocity = len(mapping) * [0.0] if has_velocity else []
+        state.effort = len(mapping) * [0.0] if has_effort else []
+        state.header.stamp = rospy.Time.now()
+        store.read_consistent(self.fill_values, (store, state, mapping, slots))
+
+        if len(self.query_cache) >= 64:
+            self.query_cache.clear()
+        self.query_cache[names] = (version, response)
+        return response
+
+    def joint_states_changed(self):
+        # Whether any published value moved by more than its joint's deadband
+        # since the last message that went out.
+        msg = self.msg
+        deadbands = self.msg_deadbands
+        for values, previous in zip((msg.position, msg.velocity, msg.effort), self.last_published):
+            if len(values) != len(previous):
+                return True
+            for value, last, deadband in zip(values, previous, deadbands):
+                if abs(value - last) > deadband:
+                    return True
+        return False
+
+    def update(self, delta):
+        if self.motion is not None:
+            self.motion.step(self.store, rospy.get_time())
+        else:
+            self.store.sweep(delta)
@@ -0,0 +1,232 @@
+# Software License Agreement (BSD License)
+#
+# Copyright (c) 2010, Willow Garage, Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#
+#  * Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+#  * Redistributions in binary form must reproduce the above
+#    copyright notice, this list of conditions and the following
+#    disclaimer in the documentation and/or other materials provided
+#    with the distribution.
+#  * Neither the name of Willow Garage, Inc. nor the names of its
+#    contributors may be used to endorse or promote products derived
+#    from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+# FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+# COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+# INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+# BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+# LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+# CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+# ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+import array
+import collections
+import heapq
+
+
+# How one entry of source_list is to be treated.  Sources with a higher
+# priority win over lower ones; a timeout of 0 means that the data of the
+# source never goes stale.  The subscription is made with queue_size and
+# tcp_nodelay, and ingest tells whether messages are taken in as they
+# arrive ('immediate') or only the latest one once per publish ('latest').
+SourceConfig = collections.namedtuple('SourceConfig', 'topic priority timeout queue_size tcp_nodelay ingest')
+
+INGEST_POLICIES = ('immediate', 'latest')
+
+
+def parse_source_list(source_list):
+    # Entries of source_list are either plain topic names or dictionaries
+    # with a 'topic' and optionally any of the other settings.
+    sources = []
+    for entry in source_list:
+        if not isinstance(entry, dict):
+            entry = {'topic': entry}
+        queue_size = entry.get('queue_size')
+        ingest = entry.get('ingest', 'immediate')
+        if ingest not in INGEST_POLICIES:
+            raise ValueError("Unknown ingest policy '%s' for source %s" % (ingest, entry['topic']))
+        sources.append(SourceConfig(entry['topic'], int(entry.get('priority', 0)),
+                                    float(entry.get('timeout', 0.0)),
+                                    None if queue_size is None else int(queue_size),
+                                    bool(entry.get('tcp_nodelay', False)), ingest))
+    return sources
+
+
+class SourceIngest(object):
+    # Counts what comes in on a source, and in the 'latest' policy holds the
+    # newest message that has not been taken in yet.
+
+    def __init__(self, config):
+        self.coalesce = config.ingest == 'latest'
+        # A deque with a single slot, since appending to and popping from it
+        # are atomic, so the subscriber thread and the publish loop need no
+        # lock between them.
+        self.pending = collections.deque(maxlen=1)
+        self.received = 0
+        self.coalesced = 0
+        # Messages lost in the subscriber queue, as seen from gaps in the
+        # header sequence numbers.
+        self.dropped = 0
+        self.last_seq = None
+
+    def count(self, msg):
+        self.received += 1
+        seq = msg.header.seq
+        if self.last_seq is not None and seq > self.last_seq + 1:
+            self.dropped += seq - self.last_seq - 1
+        self.last_seq = seq
+
+    def push(self, msg):
+        if self.pending:
+            self.coalesced += 1
+        self.pending.append(msg)
+
+    def pop(self):
+        try:
+            return self.pending.popleft()
+        except IndexError:
+            return None
+
+
+class SourceArbiter(object):
+    # Decides, joint by joint, which source gets to set its values in a
+    # JointStore.  A joint follows the highest priority source that has
+    # fresh data for it; among sources of the same priority, the most
+    # recently stamped data wins.  The latest values of every source are
+    # kept, so that when the data of the source a joint follows goes stale,
+    # the joint falls back to the best remaining source, or to its zero if
+    # there is none.
+    #
+    # Staleness is checked from a heap of per-joint deadlines, so expire()
+    # only looks at joints whose deadline has passed.  Callers serialize
+    # apply() and expire() with the store's begin_write()/end_write().
+
+    UNOWNED = -1
+
+    def __init__(self, store, sources):
+        num = len(store)
+        self.store = store
+        self.sources = sources
+        self.owner = array.array('i', [self.UNOWNED] * num)
+        self.owner_stamp = array.array('d', [0.0] * num)
+        # Per source: when its data for each joint was received (or -1 if it
+        # never was), the stamp of that data, and the values themselves.
+        self.received = [array.array('d', [-1.0] * num) for _ in sources]
+        self.stamps = [array.array('d', [0.0] * num) for _ in sources]
+        self.values = [dict((field, array.array('d', [0.0] * num)) for field in store.OPTIONAL_FIELDS)
+                       for _ in sources]
+        self.has = [dict((field, bytearray(num)) for field in store.OPTIONAL_FIELDS)
+                    for _ in sources]
+        # (deadline, slot) pairs.  An entry may be outdated by newer data,
+        # which is checked once it comes up.  scheduled holds the deadline
+        # each joint is waiting on, or 0 if none; entries that do not match
+        # it were superseded by an earlier deadline and are skipped.
+        self.deadlines = []
+        self.scheduled = array.array('d', [0.0] * num)
+
+    def apply(self, index, mapping, fields, stamp, now):
+        # Take in a message of source index; fields is a list of
+        # (field, values) pairs of the message.
+        source = self.sources[index]
+        received = self.received[index]
+        stamps = self.stamps[index]
+        values = self.values[index]
+        has = self.has[index]
+        owner = self.owner
+        owner_stamp = self.owner_stamp
+        for i, slot in zip(mapping.indices, mapping.slots):
+            received[slot] = now
+            stamps[slot] = stamp
+            for field, message_values in fields:
+                values[field][slot] = message_values[i]
+                has[field][slot] = 1
+
+            current = owner[slot]
+            if current != self.UNOWNED and not self.stale(current, slot, now):
+                priority = self.sources[current].priority
+                if source.priority < priority:
+                    continue
+                if source.priority == priority and stamp < owner_stamp[slot]:
+                    continue
+            self.take(index, slot)
+
+    def take(self, index, slot):
+        # Make the joint follow source index.
+        store = self.store
+        values = self.values[index]
+        has = self.has[index]
+        for field in store.OPTIONAL_FIELDS:
+            if has[field][slot]:
+                store.set(field, slot, values[field][slot])
+        self.owner[slot] = index
+        self.owner_stamp[slot] = self.stamps[index][slot]
+        timeout = self.sources[index].timeout
+        if timeout > 0:
+            # A new owner may go stale before the deadline the joint is
+            # already waiting on; a later one is pushed once that comes up.
+            deadline = self.received[index][slot] + timeout
+            scheduled = self.scheduled[slot]
+            if not scheduled or deadline < scheduled:
+                heapq.heappush(self.deadlines, (deadline, slot))
+                self.scheduled[slot] = deadline
+
+    def stale(self, index, slot, now):
+        # Worked out the same way as the deadlines, so that a joint whose
+        # deadline has passed is always stale.
+        timeout = self.sources[index].timeout
+        return timeout > 0 and self.received[index][slot] + timeout <= now
+
+    def next_deadline(self):
+        if self.deadlines:
+            return self.deadlines[0][0]
+        return None
+
+    def expire(self, now):
+        # Move joints whose source went stale over to their next best source.
+        deadlines = self.deadlines
+        while deadlines and deadlines[0][0] <= now:
+            deadline, slot = heapq.heappop(deadlines)
+            if deadline != self.scheduled[slot]:
+                continue
+            self.scheduled[slot] = 0
+            current = self.owner[slot]
+            if current == self.UNOWNED:
+                continue
+            if not self.stale(current, slot, now):
+                # Fresh data came in after this deadline was set, or the
+                # joint moved over to a source that never goes stale.
+                timeout = self.sources[current].timeout
+                if timeout > 0:
+                    deadline = self.received[current][slot] + timeout
+                    heapq.heappush(deadlines, (deadline, slot))
+                    self.scheduled[slot] = deadline
+                continue
+
+            best = None
+            for index, source in enumerate(self.sources):
+                if self.received[index][slot] < 0 or self.stale(index, slot, now):
+                    continue
+                if best is None or (source.priority, self.stamps[index][slot]) > \
+                        (self.sources[best].priority, self.stamps[best][slot]):
+                    best = index
+            if best is not None:
+                self.take(best, slot)
+                continue
+
+            self.owner[slot] = self.UNOWNED
+            store = self.store
+            store.set('position', slot, store.zero[slot])
+            for field in ('velocity', 'effort'):
+                if store.present[field][slot]:
+                    store.set(field, slot, 0.0)
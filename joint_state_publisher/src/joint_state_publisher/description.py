@@ -0,0 +1,314 @@
+# Software License Agreement (BSD License)
+#
+# Copyright (c) 2010, Willow Garage, Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#
+#  * Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+#  * Redistributions in binary form must reproduce the above
+#    copyright notice, this list of conditions and the following
+#    disclaimer in the documentation and/or other materials provided
+#    with the distribution.
+#  * Neither the name of Willow Garage, Inc. nor the names of its
+#    contributors may be used to endorse or promote products derived
+#    from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+# FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+# COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+# INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+# BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+# LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+# CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+# ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+import collections
+import hashlib
+import marshal
+import os
+import sys
+import tempfile
+import xml.parsers.expat
+
+import rospy
+
+# The parts of a URDF <joint> that the joint_state_publisher cares about.
+# limit is the attribute dictionary of the first <limit> in the joint (or
+# None), safety_controllers and mimics hold the attributes of every
+# <safety_controller> and <mimic> in it.
+UrdfJoint = collections.namedtuple('UrdfJoint', 'name type limit safety_controllers mimics')
+
+# A revolute or prismatic joint of a COLLADA kinematics model, with its
+# limits as written in the document (degrees for revolute joints).  type is
+# None for joints of any other kind.
+ColladaJoint = collections.namedtuple('ColladaJoint', 'name type min max')
+
+
+class _StopParsing(Exception):
+    pass
+
+
+def root_tag(description):
+    # The name of the root element, found without parsing the rest of the
+    # document.
+    tags = []
+
+    def start_element(name, attrs):
+        tags.append(name)
+        raise _StopParsing()
+
+    parser = xml.parsers.expat.ParserCreate()
+    parser.StartElementHandler = start_element
+    try:
+        parser.Parse(description, True)
+    except _StopParsing:
+        pass
+    return tags[0] if tags else None
+
+
+class _UrdfJointExtractor(object):
+    # expat handlers that pick the joints out of the first <robot> element
+    # without building a DOM of the whole description, which is mostly links,
+    # visuals and collisions.
+
+    def __init__(self):
+        self.joints = []
+        self.depth = 0
+        self.robot_depth = None
+        self.joint = None
+        self.joint_depth = None
+
+    def start_element(self, name, attrs):
+        self.depth += 1
+        if self.joint is not None:
+            if name == 'limit':
+                if self.joint['limit'] is None:
+                    self.joint['limit'] = attrs
+            elif name == 'safety_controller':
+                self.joint['safety_controllers'].append(attrs)
+            elif name == 'mimic':
+                self.joint['mimics'].append(attrs)
+        elif self.robot_depth is None:
+            if name == 'robot':
+                self.robot_depth = self.depth
+        elif self.depth == self.robot_depth + 1 and name.rsplit(':', 1)[-1] == 'joint':
+            self.joint = {'name': attrs.get('name', ''), 'type': attrs.get('type', ''),
+                          'limit': None, 'safety_controllers': [], 'mimics': []}
+            self.joint_depth = self.depth
+
+    def end_element(self, name):
+        if self.depth == self.joint_depth:
+            self.joints.append(UrdfJoint(**self.joint))
+            self.joint = None
+            self.joint_depth = None
+        elif self.depth == self.robot_depth:
+            # Only the first <robot> is looked at.
+            self.robot_depth = -1
+        self.depth -= 1
+
+
+def extract_urdf_joints(description):
+    # Stream through a URDF and return the UrdfJoint of every direct <joint>
+    # child of its <robot>, in document order.
+    extractor = _UrdfJointExtractor()
+    parser = xml.parsers.expat.ParserCreate()
+    parser.StartElementHandler = extractor.start_element
+    parser.EndElementHandler = extractor.end_element
+    parser.Parse(description, True)
+    if extractor.robot_depth is None:
+        raise ValueError("The robot description has no <robot> element.")
+    return extractor.joints
+
+
+class _ColladaJointExtractor(object):
+    # expat handlers that pick the joints out of the <technique_common> of
+    # the first <kinematics_model>.
+
+    AXIS_TYPES = ('revolute', 'prismatic')
+
+    def __init__(self):
+        self.joints = []
+        self.depth = 0
+        self.model_depth = None
+        self.technique_depth = None
+        self.joint = None
+        self.joint_depth = None
+        # Per axis type, the depth of the first such element in the joint and
+        # whether its first <limits> was seen or is open.
+        self.axis_depth = None
+        self.limits_depth = None
+        self.text = None
+
+    def start_element(self, name, attrs):
+        self.depth += 1
+        if self.joint is not None:
+            self.start_joint_element(name)
+        elif self.model_depth is None:
+            if name == 'kinematics_model':
+                self.model_depth = self.depth
+        elif self.technique_depth is None:
+            if name == 'technique_common' and self.model_depth > 0:
+                self.technique_depth = self.depth
+        elif self.depth == self.technique_depth + 1 and name.rsplit(':', 1)[-1] == 'joint':
+            self.joint = {'name': attrs.get('name', '')}
+            self.joint_depth = self.depth
+
+    def start_joint_element(self, name):
+        joint = self.joint
+        if name in self.AXIS_TYPES and name not in joint:
+            joint[name] = {}
+            self.axis_depth = (name, self.depth)
+        elif self.axis_depth is not None and self.limits_depth is None:
+            if name == 'limits' and 'limits' not in joint[self.axis_depth[0]]:
+                joint[self.axis_depth[0]]['limits'] = True
+                self.limits_depth = self.depth
+        elif self.limits_depth is not None and name in ('min', 'max'):
+            if name not in joint[self.axis_depth[0]]:
+                self.text = (name, [])
+
+    def character_data(self, data):
+        if self.text is not None:
+            self.text[1].append(data)
+
+    def end_element(self, name):
+        if self.text is not None and name == self.text[0]:
+            self.joint[self.axis_depth[0]][name] = ''.join(self.text[1])
+            self.text = None
+        if self.depth == self.limits_depth:
+            self.limits_depth = None
+        if self.axis_depth is not None and self.depth == self.axis_depth[1]:
+            self.axis_depth = None
+        if self.depth == self.joint_depth:
+            self.joints.append(self.make_joint(self.joint))
+            self.joint = None
+            self.joint_depth = None
+        elif self.depth == self.technique_depth:
+            # Only the first <technique_common> of the first
+            # <kinematics_model> is looked at.
+            self.technique_depth = -1
+        elif self.depth == self.model_depth:
+            self.model_depth = -1
+        self.depth -= 1
+
+    def make_joint(self, joint):
+        for jtype in self.AXIS_TYPES:
+            if jtype in joint:
+                axis = joint[jtype]
+                try:
+                    return ColladaJoint(joint['name'], jtype, float(axis['min']), float(axis['max']))
+                except (KeyError, ValueError):
+                    return ColladaJoint(joint['name'], jtype, None, None)
+        return ColladaJoint(joint['name'], None, None, None)
+
+
+def _extract_collada_joints(document):
+    extractor = _ColladaJointExtractor()
+    parser = xml.parsers.expat.ParserCreate()
+    parser.StartElementHandler = extractor.start_element
+    parser.EndElementHandler = extractor.end_element
+    parser.CharacterDataHandler = extractor.character_data
+    parser.Parse(document, True)
+    if extractor.technique_depth is None:
+        raise ValueError("The robot description has no <kinematics_model> with a <technique_common>.")
+    return extractor.joints
+
+
+def extract_collada_joints(description):
+    # Return the ColladaJoint of every joint of the kinematics model of a
+    # COLLADA document, in document order.
+    #
+    # Exported models carry their meshes in <library_geometries> and
+    # friends, which can make up nearly all of the document.  So the
+    # <library_kinematics_models> section is cut out and parsed on its own
+    # first; only if that fails is the whole document streamed through.
+    start_tag = '<library_kinematics_models'
+    end_tag = '</library_kinematics_models>'
+    start = description.find(start_tag)
+    end = description.find(end_tag, start)
+    if start >= 0 and end >= 0:
+        try:
+            return _extract_collada_joints(description[start:end + len(end_tag)])
+        except (xml.parsers.expat.ExpatError, ValueError):
+            pass
+    return _extract_collada_joints(description)
+
+
+# Header of the description cache files; bump the version whenever the
+# extracted tuples change shape.
+CACHE_MAGIC = b'JSPC\x01'
+
+
+def description_hash(description):
+    if not isinstance(description, bytes):
+        description = description.encode('utf-8')
+    return hashlib.sha256(description).hexdigest()
+
+
+def _cache_path(cache_dir, description):
+    # marshal data is only portable between the same major Python versions.
+    return os.path.join(cache_dir, '%s.py%d.jspcache' % (description_hash(description), sys.version_info[0]))
+
+
+def _load_cache(path):
+    try:
+        with open(path, 'rb') as f:
+            data = f.read()
+    except (IOError, OSError):
+        return None
+    if not data.startswith(CACHE_MAGIC):
+        return None
+    try:
+        kind, joints = marshal.loads(data[len(CACHE_MAGIC):])
+        if kind == 'collada':
+            return kind, [ColladaJoint(*joint) for joint in joints]
+        return kind, [UrdfJoint(*joint) for joint in joints]
+    except (EOFError, ValueError, TypeError):
+        rospy.logwarn("Ignoring corrupt description cache %s", path)
+        return None
+
+
+def _save_cache(path, kind, joints):
+    data = CACHE_MAGIC + marshal.dumps((kind, [tuple(joint) for joint in joints]))
+    directory = os.path.dirname(path)
+    try:
+        if not os.path.isdir(directory):
+            os.makedirs(directory)
+        # Write to a temporary file first so that concurrently starting nodes
+        # never see a partial cache file.
+        fd, tmp_path = tempfile.mkstemp(dir=directory, suffix='.tmp')
+        with os.fdopen(fd, 'wb') as f:
+            f.write(data)
+        os.rename(tmp_path, path)
+    except (IOError, OSError) as e:
+        rospy.logwarn("Could not write the description cache %s: %s", path, e)
+
+
+def extract_joints(description, cache_dir=None):
+    # Return ('urdf', UrdfJoints) or ('collada', ColladaJoints) for a robot
+    # description.  With a cache_dir, the result is stored there under a hash
+    # of the description, and later calls with the same description load it
+    # from there without parsing any XML.
+    path = None
+    if cache_dir:
+        path = _cache_path(cache_dir, description)
+        cached = _load_cache(path)
+        if cached is not None:
+            rospy.logdebug("Loaded the robot description joints from %s", path)
+            return cached
+
+    if root_tag(description) == 'COLLADA':
+        kind, joints = 'collada', extract_collada_joints(description)
+    else:
+        kind, joints = 'urdf', extract_urdf_joints(description)
+
+    if path is not None:
+        _save_cache(path, kind, joints)
+    return kind, joints
@@ -0,0 +1,167 @@
+# Software License Agreement (BSD License)
+#
+# Copyright (c) 2010, Willow Garage, Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#
+#  * Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+#  * Redistributions in binary form must reproduce the above
+#    copyright notice, this list of conditions and the following
+#    disclaimer in the documentation and/or other materials provided
+#    with the distribution.
+#  * Neither the name of Willow Garage, Inc. nor the names of its
+#    contributors may be used to endorse or promote products derived
+#    from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+# FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+# COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+# INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+# BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+# LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+# CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+# ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+import bisect
+
+import diagnostic_msgs.msg
+import rospy
+
+
+def format_duration(seconds):
+    if seconds < 1e-3:
+        return "%.0fus" % (seconds * 1e6)
+    if seconds < 1.0:
+        return "%.2fms" % (seconds * 1e3)
+    return "%.3fs" % seconds
+
+
+class Histogram(object):
+    # Upper bounds of the buckets, in seconds: 1-2-5 steps from 10us to 10s,
+    # plus an overflow bucket.
+    BOUNDS = [m * 10.0 ** e for e in range(-5, 1) for m in (1, 2, 5)] + [10.0]
+
+    def __init__(self):
+        self.reset()
+
+    def reset(self):
+        self.buckets = [0] * (len(self.BOUNDS) + 1)
+        self.count = 0
+        self.total = 0.0
+        self.max = 0.0
+
+    def record(self, value):
+        self.buckets[bisect.bisect_left(self.BOUNDS, value)] += 1
+        self.count += 1
+        self.total += value
+        if value > self.max:
+            self.max = value
+
+    def percentile(self, fraction):
+        # The upper bound of the bucket holding the given fraction of the
+        # samples, which is as precise as the buckets allow.
+        needed = fraction * self.count
+        seen = 0
+        for bound, count in zip(self.BOUNDS, self.buckets):
+            seen += count
+            if seen >= needed:
+                return min(bound, self.max)
+        return self.max
+
+    def summary(self):
+        if not self.count:
+            return "no samples"
+        return "n=%d mean=%s p50<=%s p90<=%s p99<=%s max=%s" % (
+            self.count, format_duration(self.total / self.count),
+            format_duration(self.percentile(0.5)), format_duration(self.percentile(0.9)),
+            format_duration(self.percentile(0.99)), format_duration(self.max))
+
+    def bucket_counts(self):
+        labels = ["<=" + format_duration(bound) for bound in self.BOUNDS] + [">" + format_duration(self.BOUNDS[-1])]
+        return " ".join("%s:%d" % (label, count) for label, count in zip(labels, self.buckets) if count)
+
+
+class LoopStatistics(object):
+    # Per-cycle timings of the publish loop, aggregated into histograms and
+    # published as a DiagnosticArray every 1 / rate seconds.
+    #
+    #   update      time spent in JointStatePublisher.update()
+    #   build       time spent filling in the message
+    #   publish     time spent in Publisher.publish()
+    #   sleep       time spent waiting for the next cycle
+    #   source_age  age of the newest source data when a message goes out
+    #   interval    time between two published messages
+    NAMES = ('update', 'build', 'publish', 'sleep', 'source_age', 'interval')
+
+    def __init__(self, rate, clock, namespace=None):
+        self.histograms = dict((name, Histogram()) for name in self.NAMES)
+        self.period = 1.0 / rate
+        self.clock = clock
+        self.next_report = None
+        self.last_publish = None
+        self.last_missed = 0
+        self.sources = []
+        if namespace is None:
+            self.status_name = "%s: publish loop" % rospy.get_name()
+        else:
+            self.status_name = "%s: publish loop of %s" % (rospy.get_name(), namespace)
+        self.pub = rospy.Publisher('diagnostics', diagnostic_msgs.msg.DiagnosticArray, queue_size=1)
+
+    def record(self, name, value):
+        self.histograms[name].record(value)
+
+    def record_publish(self, now):
+        if self.last_publish is not None:
+            self.record('interval', now - self.last_publish)
+        self.last_publish = now
+
+    def add_source(self, topic, ingest):
+        # Report the message counts of a source along with the timings.
+        self.sources.append((topic, ingest))
+
+    def report(self, now, scheduler=None):
+        # Publish the histograms if a report is due, and start a new window.
+        if self.next_report is None:
+            self.next_report = now + self.period
+            return
+        if now < self.next_report:
+            return
+        self.next_report += self.period
+        if self.next_report <= now:
+            self.next_report = now + self.period
+
+        status = diagnostic_msgs.msg.DiagnosticStatus()
+        status.name = self.status_name
+        status.level = diagnostic_msgs.msg.DiagnosticStatus.OK
+        status.message = "OK"
+        for name in self.NAMES:
+            histogram = self.histograms[name]
+            status.values.append(diagnostic_msgs.msg.KeyValue(name, histogram.summary()))
+            status.values.append(diagnostic_msgs.msg.KeyValue(name + " histogram", histogram.bucket_counts()))
+            histogram.reset()
+        if scheduler is not None:
+            status.values.append(diagnostic_msgs.msg.KeyValue("cycles", str(scheduler.ticks)))
+            status.values.append(diagnostic_msgs.msg.KeyValue("missed deadlines", str(scheduler.missed)))
+            status.values.append(diagnostic_msgs.msg.KeyValue("max lateness", format_duration(scheduler.max_lateness)))
+            status.values.append(diagnostic_msgs.msg.KeyValue("clock jumps", str(scheduler.resyncs)))
+            if scheduler.missed != self.last_missed:
+                status.level = diagnostic_msgs.msg.DiagnosticStatus.WARN
+                status.message = "Missed %d deadlines" % (scheduler.missed - self.last_missed)
+                self.last_missed = scheduler.missed
+        for topic, ingest in self.sources:
+            status.values.append(diagnostic_msgs.msg.KeyValue(
+                "source " + topic, "%d received, %d coalesced, %d dropped" %
+                (ingest.received, ingest.coalesced, ingest.dropped)))
+
+        array = diagnostic_msgs.msg.DiagnosticArray()
+        array.header.stamp = rospy.Time.now()
+        array.status.append(status)
+        self.pub.publish(array)
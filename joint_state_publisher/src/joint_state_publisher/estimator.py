@@ -0,0 +1,133 @@
+# Software License Agreement (BSD License)
+#
+# Copyright (c) 2010, Willow Garage, Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#
+#  * Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+#  * Redistributions in binary form must reproduce the above
+#    copyright notice, this list of conditions and the following
+#    disclaimer in the documentation and/or other materials provided
+#    with the distribution.
+#  * Neither the name of Willow Garage, Inc. nor the names of its
+#    contributors may be used to endorse or promote products derived
+#    from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+# FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+# COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+# INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+# BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+# LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+# CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+# ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+import array
+
+
+class PositionEstimator(object):
+    # Estimates where the joints fed by sources are at the time a message
+    # is published, rather than where they were when the source stamped its
+    # data.  The last two samples of each joint are kept; a publish time in
+    # between them is interpolated, and one past the newest sample is
+    # extrapolated with the velocity the source sent (or else the one
+    # implied by the two samples), for at most max_extrapolation seconds.
+
+    def __init__(self, store, max_extrapolation, names=None):
+        num = len(store)
+        self.max_extrapolation = max_extrapolation
+        self.enabled = bytearray(num)
+        if names is None:
+            self.enabled = bytearray([1] * num)
+        else:
+            for name in names:
+                slot = store.slots.get(name)
+                if slot is not None:
+                    self.enabled[slot] = 1
+        # Number of samples held for each joint, up to two; the older one is
+        # (t0, p0), the newer one (t1, p1, v1).
+        self.samples = bytearray(num)
+        self.t0 = array.array('d', [0.0] * num)
+        self.p0 = array.array('d', [0.0] * num)
+        self.t1 = array.array('d', [0.0] * num)
+        self.p1 = array.array('d', [0.0] * num)
+        self.v1 = array.array('d', [0.0] * num)
+        self.has_velocity = bytearray(num)
+        # The joints that have samples, so that estimate() only visits them.
+        self.active = []
+
+    def record(self, mapping, stamp, positions, velocities, owner=None, source=None):
+        # Take the positions (and velocities, if any) of a source message
+        # stamped at stamp.  When owner is given, only the joints it shows
+        # to follow source are taken.
+        samples = self.samples
+        t0 = self.t0
+        p0 = self.p0
+        t1 = self.t1
+        p1 = self.p1
+        v1 = self.v1
+        for i, slot in zip(mapping.indices, mapping.slots):
+            if not self.enabled[slot]:
+                continue
+            if owner is not None and owner[slot] != source:
+                continue
+            held = samples[slot]
+            if held == 0:
+                self.active.append(slot)
+            elif stamp < t1[slot]:
+                # Out of order; the newer sample stays.
+                continue
+            elif stamp > t1[slot]:
+                t0[slot] = t1[slot]
+                p0[slot] = p1[slot]
+                held = min(held + 1, 2)
+            t1[slot] = stamp
+            p1[slot] = positions[i]
+            if velocities:
+                v1[slot] = velocities[i]
+                self.has_velocity[slot] = 1
+            else:
+                self.has_velocity[slot] = 0
+            samples[slot] = max(held, 1)
+
+    def estimate(self, position, now):
+        # Returns a copy of the position array with the estimates at time
+        # now filled in.
+        estimated = array.array('d', position)
+        samples = self.samples
+        t0 = self.t0
+        p0 = self.p0
+        t1 = self.t1
+        p1 = self.p1
+        max_extrapolation = self.max_extrapolation
+        for slot in self.active:
+            if position[slot] != p1[slot]:
+                # Something other than the sources (the GUI, say) moved the
+                # joint since; it is published as is.
+                continue
+            ahead = now - t1[slot]
+            two = samples[slot] == 2 and t1[slot] > t0[slot]
+            if ahead >= 0:
+                if self.has_velocity[slot]:
+                    velocity = self.v1[slot]
+                elif two:
+                    velocity = (p1[slot] - p0[slot]) / (t1[slot] - t0[slot])
+                else:
+                    continue
+                estimated[slot] = p1[slot] + velocity * min(ahead, max_extrapolation)
+            elif two:
+                # The newest sample is stamped after now.
+                if now <= t0[slot]:
+                    estimated[slot] = p0[slot]
+                else:
+                    fraction = (now - t0[slot]) / (t1[slot] - t0[slot])
+                    estimated[slot] = p0[slot] + (p1[slot] - p0[slot]) * fraction
+        return estimated
@@ -0,0 +1,120 @@
+# Software License Agreement (BSD License)
+#
+# Copyright (c) 2010, Willow Garage, Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#
+#  * Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+#  * Redistributions in binary form must reproduce the above
+#    copyright notice, this list of conditions and the following
+#    disclaimer in the documentation and/or other materials provided
+#    with the distribution.
+#  * Neither the name of Willow Garage, Inc. nor the names of its
+#    contributors may be used to endorse or promote products derived
+#    from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+# FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+# COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+# INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+# BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+# LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+# CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+# ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+import re
+
+import rospy
+import sensor_msgs.msg
+
+
+class JointGroup(object):
+    # A subset of the published joints that also goes out on a topic of
+    # its own, at its own rate.  Which entries of the combined message make
+    # up the group is worked out once per joint table, so publishing the
+    # group is a plain gather (or slice) of the combined message's values.
+
+    FIELDS = ('position', 'velocity', 'effort')
+
+    def __init__(self, name, joints=None, pattern=None, topic=None, rate=0.0):
+        if (joints is None) == (pattern is None):
+            raise ValueError("Joint group '%s' needs either 'joints' or 'pattern'" % name)
+        self.name = name
+        self.joints = None if joints is None else list(joints)
+        self.regex = None if pattern is None else re.compile('(?:%s)$' % pattern)
+        self.period = 1.0 / rate if rate > 0 else 0.0
+        self.next_publish = None
+        self.pub = rospy.Publisher(topic or name + '/joint_states', sensor_msgs.msg.JointState, queue_size=5)
+        self.msg = sensor_msgs.msg.JointState()
+        self.indices = []
+        self.span = None
+
+    def bind(self, names):
+        # Find the group's joints among the names of the combined message.
+        if self.joints is not None:
+            wanted = set(self.joints)
+            missing = wanted.difference(names)
+            if missing:
+                rospy.logwarn("Joint group '%s' names unknown joints: %s", self.name, ', '.join(sorted(missing)))
+            self.indices = [i for i, name in enumerate(names) if name in wanted]
+        else:
+            self.indices = [i for i, name in enumerate(names) if self.regex.match(name)]
+        self.msg = sensor_msgs.msg.JointState()
+        self.msg.name = [names[i] for i in self.indices]
+        num = len(self.indices)
+        self.span = None
+        if num > 0 and self.indices == list(range(self.indices[0], self.indices[0] + num)):
+            self.span = (self.indices[0], self.indices[0] + num)
+
+    def update_layout(self, msg):
+        num = len(self.indices)
+        for field in self.FIELDS:
+            setattr(self.msg, field, num * [0.0] if getattr(msg, field) else [])
+
+    def due(self, now):
+        if self.period == 0.0:
+            return True
+        if self.next_publish is not None and now < self.next_publish:
+            return False
+        if self.next_publish is None or now - self.next_publish >= self.period:
+            self.next_publish = now + self.period
+        else:
+            self.next_publish += self.period
+        return True
+
+    def publish(self, msg):
+        # Publish the group's share of the combined message msg.
+        if not self.indices:
+            return
+        group_msg = self.msg
+        for field in self.FIELDS:
+            values = getattr(msg, field)
+            if not values:
+                continue
+            if self.span is not None:
+                getattr(group_msg, field)[:] = values[self.span[0]:self.span[1]]
+            else:
+                getattr(group_msg, field)[:] = [values[i] for i in self.indices]
+        group_msg.header.stamp = msg.header.stamp
+        self.pub.publish(group_msg)
+
+
+def parse_joint_groups(joint_groups, resolve=str):
+    # joint_groups maps each group name to a dictionary with either the
+    # list of 'joints' or a 'pattern' matching their names, and optionally
+    # a 'topic' and a 'rate'.  resolve maps topic names into a namespace.
+    groups = []
+    for name in sorted(joint_groups):
+        config = joint_groups[name]
+        groups.append(JointGroup(name, config.get('joints'), config.get('pattern'),
+                                 resolve(config.get('topic') or name + '/joint_states'),
+                                 float(config.get('rate', 0.0))))
+    return groups
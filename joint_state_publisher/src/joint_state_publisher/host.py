@@ -0,0 +1,91 @@
+# Software License Agreement (BSD License)
+#
+# Copyright (c) 2010, Willow Garage, Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#
+#  * Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+#  * Redistributions in binary form must reproduce the above
+#    copyright notice, this list of conditions and the following
+#    disclaimer in the documentation and/or other materials provided
+#    with the distribution.
+#  * Neither the name of Willow Garage, Inc. nor the names of its
+#    contributors may be used to endorse or promote products derived
+#    from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+# FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+# COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+# INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+# BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+# LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+# CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+# ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+import xml.parsers.expat
+
+import rospy
+
+from . import JointStatePublisher, ParamSnapshot
+from .scheduler import Scheduler, monotonic
+
+
+class JointStatePublisherHost(object):
+    # Serves several robots from one process: one JointStatePublisher per
+    # robot namespace, all published from a single loop.  Each robot reads
+    # its parameters (robot_description, source_list, ...) from its own
+    # namespace first, and falls back to the private parameters of the
+    # host, so that settings common to all robots are given only once.
+    # The rate, delta and deadline_policy of the loop are those of the host;
+    # robots in lockstep publish the steps they queued once per cycle.
+
+    def __init__(self, namespaces):
+        self.params = ParamSnapshot()
+        self.publishers = []
+        for namespace in namespaces:
+            try:
+                jsp = JointStatePublisher(namespace, ParamSnapshot(namespace, self.params))
+            except (RuntimeError, ValueError, xml.parsers.expat.ExpatError) as e:
+                # One broken robot should not take the others down.
+                rospy.logerr("Not publishing joint states for %s: %s", namespace, e)
+                continue
+            self.publishers.append(jsp)
+        rospy.loginfo("Publishing joint states for %d robots", len(self.publishers))
+
+    def loop(self):
+        delta = self.params.get("delta", 0.0)
+        hz = self.params.get("rate", 10)
+        policy = self.params.get("deadline_policy", "skip")
+        if rospy.rostime.is_wallclock():
+            scheduler = Scheduler(hz, policy)
+        else:
+            scheduler = Scheduler.for_ros_time(hz, policy)
+
+        missed = 0
+        scheduler.start()
+        while not rospy.is_shutdown():
+            for jsp in self.publishers:
+                if jsp.lockstep:
+                    # Robots in lockstep publish every step queued since the
+                    # last cycle, rather than once per cycle.
+                    jsp.drain_lockstep(delta)
+                else:
+                    if delta > 0 or jsp.motion is not None:
+                        jsp.timed_update(delta)
+                    jsp.publish_joint_states()
+                if jsp.stats is not None:
+                    jsp.stats.report(monotonic(), scheduler)
+
+            scheduler.sleep()
+            if scheduler.missed != missed:
+                missed = scheduler.missed
+                rospy.logwarn_throttle(10.0, "Publishing for %d robots can not keep up with a rate of %s Hz; "
+                                       "%d deadlines missed so far" % (len(self.publishers), hz, missed))
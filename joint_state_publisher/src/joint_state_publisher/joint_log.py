@@ -0,0 +1,227 @@
+# Software License Agreement (BSD License)
+#
+# Copyright (c) 2010, Willow Garage, Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#
+#  * Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+#  * Redistributions in binary form must reproduce the above
+#    copyright notice, this list of conditions and the following
+#    disclaimer in the documentation and/or other materials provided
+#    with the distribution.
+#  * Neither the name of Willow Garage, Inc. nor the names of its
+#    contributors may be used to endorse or promote products derived
+#    from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+# FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+# COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+# INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+# BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+# LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+# CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+# ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+import array
+import mmap
+import struct
+import sys
+
+# A joint log holds a sequence of published joint states.  After the magic
+# come records of two kinds, each starting with a tag byte:
+#
+#   'L'  a layout: the number of joints, a bit mask of the fields present
+#        (position, velocity, effort), the length of the names, and the
+#        joint names separated by newlines in UTF-8;
+#   'F'  a frame: the stamp, followed by the values of each field present,
+#        joint by joint, as little-endian float64.
+#
+# A layout applies to all frames after it, so names are only written again
+# when the set of joints or fields changes.
+LOG_MAGIC = b'JSPLOG\x01'
+FIELDS = ('position', 'velocity', 'effort')
+LAYOUT_TAG = b'L'
+FRAME_TAG = b'F'
+_LAYOUT = struct.Struct('<III')
+_STAMP = struct.Struct('<d')
+
+_SWAP = sys.byteorder != 'little'
+
+
+def _to_bytes(values):
+    if _SWAP:
+        values = array.array('d', values)
+        values.byteswap()
+    if hasattr(values, 'tobytes'):
+        return values.tobytes()
+    return values.tostring()
+
+
+def _from_bytes(data):
+    values = array.array('d')
+    if hasattr(values, 'frombytes'):
+        values.frombytes(data)
+    else:
+        values.fromstring(data)
+    if _SWAP:
+        values.byteswap()
+    return values
+
+
+class JointLogWriter(object):
+    def __init__(self, path):
+        self.file = open(path, 'wb')
+        self.file.write(LOG_MAGIC)
+        self.names = None
+        self.mask = None
+
+    def write(self, msg):
+        # The name list of the message is only replaced when the joints
+        # change, so comparing it by identity is enough.
+        mask = (1 if msg.position else 0) | (2 if msg.velocity else 0) | (4 if msg.effort else 0)
+        if msg.name is not self.names or mask != self.mask:
+            names = '\n'.join(msg.name).encode('utf-8')
+            self.file.write(LAYOUT_TAG + _LAYOUT.pack(len(msg.name), mask, len(names)) + names)
+            self.names = msg.name
+            self.mask = mask
+        values = array.array('d', msg.position)
+        values.extend(msg.velocity)
+        values.extend(msg.effort)
+        self.file.write(FRAME_TAG + _STAMP.pack(msg.header.stamp.to_sec()) + _to_bytes(values))
+
+    def flush(self):
+        self.file.flush()
+
+    def close(self):
+        self.file.close()
+
+
+class JointLogReader(object):
+    # Reads the frames of a joint log one after the other, straight from a
+    # memory map of the file.
+
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            self.map = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        if self.map[:len(LOG_MAGIC)] != LOG_MAGIC:
+            raise ValueError("%s is not a joint log" % path)
+        self.rewind()
+
+    def rewind(self):
+        self.offset = len(LOG_MAGIC)
+        self.names = []
+        self.fields = ()
+        self.frame_size = 0
+
+    def peek_stamp(self):
+        # The stamp of the next frame, or None at the end of the log.
+        # Layout records on the way are taken in.  The writer is buffered,
+        # so a recording that was killed may end in the middle of a record
+        # of either kind, which is taken for the end of the log.
+        data = self.map
+        while self.offset < len(data):
+            tag = data[self.offset:self.offset + 1]
+            if tag == FRAME_TAG:
+                if not self.frame_size:
+                    raise ValueError("Corrupt joint log, frame without a layout at offset %d" % self.offset)
+                if self.offset + self.frame_size > len(data):
+                    return None
+                return _STAMP.unpack_from(data, self.offset + 1)[0]
+            if tag != LAYOUT_TAG:
+                raise ValueError("Corrupt joint log at offset %d" % self.offset)
+            start = self.offset + 1 + _LAYOUT.size
+            if start > len(data):
+                return None
+            num, mask, length = _LAYOUT.unpack_from(data, self.offset + 1)
+            if start + length > len(data):
+                return None
+            names = data[start:start + length].decode('utf-8')
+            self.names = names.split('\n') if num else []
+            self.fields = tuple(field for bit, field in enumerate(FIELDS) if mask & (1 << bit))
+            self.frame_size = 1 + _STAMP.size + 8 * num * len(self.fields)
+            self.offset = start + length
+        return None
+
+    def skip(self):
+        self.offset += self.frame_size
+
+    def tell(self):
+        return (self.offset, self.names, self.fields, self.frame_size)
+
+    def seek(self, position):
+        # Go back to a position returned by tell().
+        self.offset, self.names, self.fields, self.frame_size = position
+
+    def read(self):
+        # The current frame as (stamp, names, {field: values}); moves on to
+        # the next one.
+        start = self.offset + 1 + _STAMP.size
+        stamp = _STAMP.unpack_from(self.map, self.offset + 1)[0]
+        values = _from_bytes(self.map[start:self.offset + self.frame_size])
+        num = len(self.names)
+        frame = dict((field, values[i * num:(i + 1) * num]) for i, field in enumerate(self.fields))
+        self.offset += self.frame_size
+        return stamp, self.names, frame
+
+    def close(self):
+        self.map.close()
+
+
+class JointLogReplayer(object):
+    # Replays a joint log against a clock, scaled by rate, optionally over
+    # and over.  sample() returns the newest frame due since the last call,
+    # skipping (without decoding) the frames in between.
+
+    def __init__(self, reader, rate=1.0, loop=False):
+        self.reader = reader
+        self.rate = rate
+        self.loop = loop
+        self.start = None
+        self.first_stamp = None
+        self.finished = False
+
+    def sample(self, now):
+        if self.finished:
+            return None
+        reader = self.reader
+        if self.start is None:
+            if not now:
+                # Under use_sim_time, wait for the first /clock message.
+                return None
+            self.first_stamp = reader.peek_stamp()
+            if self.first_stamp is None:
+                self.finished = True
+                return None
+            self.start = now
+        target = self.first_stamp + (now - self.start) * self.rate
+
+        due = None
+        while True:
+            stamp = reader.peek_stamp()
+            if stamp is None:
+                if due is not None:
+                    break
+                if not self.loop:
+                    self.finished = True
+                    return None
+                # Start over from the first frame, right away.
+                reader.rewind()
+                self.start = now
+                target = self.first_stamp
+                continue
+            if stamp > target:
+                break
+            due = reader.tell()
+            reader.skip()
+        if due is None:
+            return None
+        reader.seek(due)
+        return reader.read()
@@ -0,0 +1,327 @@
+# Software License Agreement (BSD License)
+#
+# Copyright (c) 2010, Willow Garage, Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#
+#  * Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+#  * Redistributions in binary form must reproduce the above
+#    copyright notice, this list of conditions and the following
+#    disclaimer in the documentation and/or other materials provided
+#    with the distribution.
+#  * Neither the name of Willow Garage, Inc. nor the names of its
+#    contributors may be used to endorse or promote products derived
+#    from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+# FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+# COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+# INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+# BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+# LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+# CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+# ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+import array
+import threading
+
+try:
+    from collections.abc import MutableMapping
+except ImportError:
+    from collections import MutableMapping
+
+
+class JointStore(object):
+    # Numeric joint values, each kept in its own contiguous float64 array
+    # indexed by joint slot.
+    NUMERIC_FIELDS = ('position', 'velocity', 'effort', 'min', 'max', 'zero')
+    # The fields a joint may or may not have; an absent field reads as 0.0
+    # from its array but is hidden from the dict-style views.
+    OPTIONAL_FIELDS = ('position', 'velocity', 'effort')
+
+    def __init__(self, joints):
+        # joints is a sequence of (name, dict) pairs as produced by
+        # init_urdf()/init_collada(); the order of the sequence gives the
+        # slots.
+        self.names = []
+        self.slots = {}
+        self.arrays = {}
+        for field in self.NUMERIC_FIELDS:
+            self.arrays[field] = array.array('d')
+        self.present = {}
+        self.present_count = {}
+        for field in self.OPTIONAL_FIELDS:
+            self.present[field] = bytearray()
+            self.present_count[field] = 0
+        self.continuous = bytearray()
+        self.forward = bytearray()
+        self.extras = []
+        # Bumped every time a field shows up on a joint that did not have it,
+        # so that consumers can cheaply tell when to recompute what they
+        # publish.
+        self.layout_version = 0
+
+        # Dict-style access for code (such as joint_state_publisher_gui) that
+        # treats each joint as a dictionary.
+        self.joints = {}
+
+        # Writers bracket their changes with begin_write()/end_write(), which
+        # makes sequence odd while a write is in progress.  Readers take a
+        # consistent snapshot by copying what they need and retrying if the
+        # sequence moved meanwhile, so they never wait on the writers; only
+        # the writers serialize among themselves on write_lock.
+        self.write_lock = threading.Lock()
+        self.sequence = 0
+
+        for name, joint in joints:
+            self.add(name, joint)
+
+        self.position = self.arrays['position']
+        self.velocity = self.arrays['velocity']
+        self.effort = self.arrays['effort']
+        self.min = self.arrays['min']
+        self.max = self.arrays['max']
+        self.zero = self.arrays['zero']
+
+    def __len__(self):
+        return len(self.names)
+
+    def add(self, name, joint):
+        slot = len(self.names)
+        self.names.append(name)
+        self.slots[name] = slot
+        for field in self.NUMERIC_FIELDS:
+            self.arrays[field].append(float(joint.get(field, 0.0)))
+        for field in self.OPTIONAL_FIELDS:
+            self.present[field].append(0)
+            if field in joint:
+                self.mark_present(field, slot)
+        self.continuous.append(1 if joint.get('continuous', False) else 0)
+        self.forward.append(1 if joint.get('forward', True) else 0)
+        extra = {}
+        for key, value in joint.items():
+            if key not in self.NUMERIC_FIELDS and key not in ('continuous', 'forward'):
+                extra[key] = value
+        self.extras.append(extra)
+        self.joints[name] = JointView(self, slot)
+        return slot
+
+    def begin_write(self):
+        self.write_lock.acquire()
+        self.sequence += 1
+
+    def end_write(self):
+        self.sequence += 1
+        self.write_lock.release()
+
+    def read_consistent(self, read, args=(), retries=10):
+        # Call read(*args) until it ran without a write overlapping it.
+        # Under sustained writes, fall back to holding off the writers once.
+        for _ in range(retries):
+            sequence = self.sequence
+            if not sequence & 1:
+                read(*args)
+                if self.sequence == sequence:
+                    return
+        with self.write_lock:
+            read(*args)
+
+    def mark_present(self, field, slot):
+        self.present[field][slot] = 1
+        self.present_count[field] += 1
+        self.layout_version += 1
+
+    def set(self, field, slot, value):
+        self.arrays[field][slot] = value
+        present = self.present.get(field)
+        if present is not None and not present[slot]:
+            self.mark_present(field, slot)
+
+    def clear(self, field, slot):
+        present = self.present[field]
+        if present[slot]:
+            present[slot] = 0
+            self.present_count[field] -= 1
+            self.layout_version += 1
+        self.arrays[field][slot] = 0.0
+
+    def all_present(self, field):
+        return self.present_count[field] == len(self.names)
+
+    def any_present(self, field):
+        return self.present_count[field] > 0
+
+    def same_joints(self, other):
+        # Whether other holds the same joints with the same limits and zeros.
+        return (self.names == other.names and self.continuous == other.continuous and
+                all(self.arrays[field] == other.arrays[field] for field in ('min', 'max', 'zero')))
+
+    def copy_values_from(self, other):
+        # Take over the values of the joints that other has too; returns how
+        # many joints that was.
+        kept = 0
+        for name, slot in self.slots.items():
+            other_slot = other.slots.get(name)
+            if other_slot is None:
+                continue
+            kept += 1
+            for field in self.OPTIONAL_FIELDS:
+                if other.present[field][other_slot]:
+                    self.set(field, slot, other.arrays[field][other_slot])
+            self.forward[slot] = other.forward[other_slot]
+        return kept
+
+    def sweep(self, delta):
+        # Move every joint by delta towards its current direction of travel,
+        # bouncing off the limits (or wrapping around for continuous joints).
+        position = self.position
+        lower = self.min
+        upper = self.max
+        continuous = self.continuous
+        forward = self.forward
+        self.begin_write()
+        for slot in range(len(position)):
+            if forward[slot]:
+                value = position[slot] + delta
+                if value > upper[slot]:
+                    if continuous[slot]:
+                        value = lower[slot]
+                    else:
+                        value = upper[slot]
+                        forward[slot] = 0
+            else:
+                value = position[slot] - delta
+                if value < lower[slot]:
+                    value = lower[slot]
+                    forward[slot] = 1
+            position[slot] = value
+        self.end_write()
+
+
+class SourceMapping(object):
+    # Where the entries of a JointState message with a given name list go in
+    # a JointStore.  Sources nearly always send the same names in the same
+    # order, so this is worked out once per source and reused for as long as
+    # matches() holds.
+
+    __slots__ = ('store', 'names', 'indices', 'slots', 'span', 'marked')
+
+    def __init__(self, store, names):
+        self.store = store
+        self.names = list(names)
+        self.indices = []
+        self.slots = []
+        for i, name in enumerate(names):
+            slot = store.slots.get(name)
+            if slot is not None:
+                self.indices.append(i)
+                self.slots.append(slot)
+        # When the message holds exactly a run of consecutive slots, in
+        # order, its values can be copied over as one slice.
+        num = len(self.slots)
+        self.span = None
+        if num == len(names) and num > 0 and self.slots == list(range(self.slots[0], self.slots[0] + num)):
+            self.span = (self.slots[0], self.slots[0] + num)
+        # The store's layout version at which each field was last known to
+        # be present on all of our slots.
+        self.marked = {}
+
+    def matches(self, store, names):
+        return store is self.store and names == self.names
+
+    def scatter(self, field, values):
+        store = self.store
+        if self.marked.get(field) != store.layout_version:
+            # Some of our joints may not have had this field yet.
+            for i, slot in zip(self.indices, self.slots):
+                store.set(field, slot, values[i])
+            self.marked[field] = store.layout_version
+        elif self.span is not None and len(values) >= len(self.names):
+            start, end = self.span
+            store.arrays[field][start:end] = array.array('d', values[:end - start])
+        else:
+            target = store.arrays[field]
+            for i, slot in zip(self.indices, self.slots):
+                target[slot] = values[i]
+
+
+class JointView(MutableMapping):
+    # A lightweight dictionary view onto one slot of a JointStore.
+
+    __slots__ = ('store', 'slot')
+
+    def __init__(self, store, slot):
+        self.store = store
+        self.slot = slot
+
+    def __getitem__(self, key):
+        store = self.store
+        if key in store.arrays:
+            present = store.present.get(key)
+            if present is not None and not present[self.slot]:
+                raise KeyError(key)
+            return store.arrays[key][self.slot]
+        if key == 'continuous':
+            if not store.continuous[self.slot]:
+                raise KeyError(key)
+            return True
+        if key == 'forward':
+            return bool(store.forward[self.slot])
+        return store.extras[self.slot][key]
+
+    def __setitem__(self, key, value):
+        store = self.store
+        if key in store.arrays:
+            store.begin_write()
+            try:
+                store.set(key, self.slot, value)
+            finally:
+                store.end_write()
+        elif key == 'continuous':
+            store.continuous[self.slot] = 1 if value else 0
+        elif key == 'forward':
+            store.forward[self.slot] = 1 if value else 0
+        else:
+            store.extras[self.slot][key] = value
+
+    def __delitem__(self, key):
+        store = self.store
+        if key in store.present:
+            if not store.present[key][self.slot]:
+                raise KeyError(key)
+            store.begin_write()
+            try:
+                store.clear(key, self.slot)
+            finally:
+                store.end_write()
+        elif key == 'continuous' and store.continuous[self.slot]:
+            store.continuous[self.slot] = 0
+        else:
+            del store.extras[self.slot][key]
+
+    def __iter__(self):
+        store = self.store
+        slot = self.slot
+        for field in JointStore.NUMERIC_FIELDS:
+            present = store.present.get(field)
+            if present is None or present[slot]:
+                yield field
+        if store.continuous[slot]:
+            yield 'continuous'
+        yield 'forward'
+        for key in store.extras[slot]:
+            yield key
+
+    def __len__(self):
+        return sum(1 for _ in self)
+
+    def __repr__(self):
+        return repr(dict(self))
@@ -0,0 +1,206 @@
+# Software License Agreement (BSD License)
+#
+# Copyright (c) 2010, Willow Garage, Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#
+#  * Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+#  * Redistributions in binary form must reproduce the above
+#    copyright notice, this list of conditions and the following
+#    disclaimer in the documentation and/or other materials provided
+#    with the distribution.
+#  * Neither the name of Willow Garage, Inc. nor the names of its
+#    contributors may be used to endorse or promote products derived
+#    from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+# FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+# COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+# INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+# BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+# LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+# CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+# ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+import array
+import math
+import random
+
+
+def _per_joint(value, names, default):
+    # A setting given either once for all joints, or as a dictionary of
+    # joint names to values (joints left out get the default).
+    if isinstance(value, dict):
+        return [float(value.get(name, default)) for name in names]
+    if value is None:
+        value = default
+    return [float(value)] * len(names)
+
+
+def _mark_positions(store):
+    # Every joint has a position from now on, even those that would not
+    # have one published by default.  Called within a write of the store.
+    present = store.present['position']
+    for slot in range(len(store)):
+        if not present[slot]:
+            store.mark_present('position', slot)
+
+
+class MotionGenerator(object):
+    # Moves all joints of a JointStore at once according to a pattern, for
+    # demos and for load testing what consumes the joint states.  step()
+    # is given the current time in seconds; each pattern computes the new
+    # positions of all joints in one pass over the store's arrays and
+    # writes them back as a whole.  Settings that do not depend on the
+    # joints are checked by the constructor, so that a bad motion parameter
+    # is reported at startup rather than from the publish loop.
+
+    def __init__(self, config):
+        self.config = config
+        self.store = None
+        self.last_time = None
+        self.marked = False
+
+    def step(self, store, now):
+        if store is not self.store:
+            # First step, or the joints changed since.
+            self.store = store
+            self.bind(store)
+            self.marked = False
+        dt = 0.0 if self.last_time is None else max(0.0, now - self.last_time)
+        self.last_time = now
+        positions = self.positions(store, now, dt)
+        store.begin_write()
+        try:
+            if not self.marked:
+                _mark_positions(store)
+                self.marked = True
+            store.position[:] = positions
+        finally:
+            store.end_write()
+
+    def bind(self, store):
+        pass
+
+    def positions(self, store, now, dt):
+        raise NotImplementedError
+
+
+class TriangleSweep(MotionGenerator):
+    # Every joint moves back and forth between its limits at speed, the
+    # same as the delta parameter does per cycle (continuous joints wrap
+    # around).
+    def __init__(self, config):
+        MotionGenerator.__init__(self, config)
+        self.speed = float(config.get('speed', 1.0))
+
+    def step(self, store, now):
+        if store is not self.store:
+            self.store = store
+            store.begin_write()
+            try:
+                _mark_positions(store)
+            finally:
+                store.end_write()
+        dt = 0.0 if self.last_time is None else max(0.0, now - self.last_time)
+        self.last_time = now
+        store.sweep(self.speed * dt)
+
+
+class Sinusoid(MotionGenerator):
+    # Every joint swings around the middle of its range, with a frequency
+    # (Hz) and phase (rad) of its own, over amplitude times half its range.
+    def __init__(self, config):
+        MotionGenerator.__init__(self, config)
+        amplitude = config.get('amplitude')
+        amplitudes = amplitude.values() if isinstance(amplitude, dict) else [amplitude]
+        for value in amplitudes:
+            if value is not None and not 0.0 <= float(value) <= 1.0:
+                raise ValueError("The amplitude of the sine motion must be between 0 and 1, not %s" % value)
+
+    def bind(self, store):
+        names = store.names
+        amplitude = _per_joint(self.config.get('amplitude'), names, 1.0)
+        self.centre = [(lower + upper) / 2 for lower, upper in zip(store.min, store.max)]
+        self.half = [a * (upper - lower) / 2 for a, lower, upper in zip(amplitude, store.min, store.max)]
+        self.omega = [2 * math.pi * f for f in _per_joint(self.config.get('frequency'), names, 0.5)]
+        self.phase = _per_joint(self.config.get('phase'), names, 0.0)
+        self.start = None
+
+    def positions(self, store, now, dt):
+        if self.start is None:
+            self.start = now
+        t = now - self.start
+        sin = math.sin
+        return array.array('d', [c + h * sin(w * t + p)
+                                 for c, h, w, p in zip(self.centre, self.half, self.omega, self.phase)])
+
+
+class RandomWalk(MotionGenerator):
+    # Every joint takes random steps of at most speed (rad/s) per second,
+    # reflected back into its limits.
+    def bind(self, store):
+        self.speed = _per_joint(self.config.get('speed'), store.names, 1.0)
+        self.random = random.Random(self.config.get('seed'))
+
+    def positions(self, store, now, dt):
+        uniform = self.random.uniform
+        result = array.array('d')
+        for value, speed, lower, upper in zip(store.position, self.speed, store.min, store.max):
+            value += uniform(-speed, speed) * dt
+            if value > upper:
+                value = max(lower, 2 * upper - value)
+            elif value < lower:
+                value = min(upper, 2 * lower - value)
+            result.append(value)
+        return result
+
+
+class StepSequence(MotionGenerator):
+    # All joints jump through a sequence of values, each held for period
+    # seconds; the values are fractions of each joint's range (0 being its
+    # lower and 1 its upper limit).
+    def __init__(self, config):
+        MotionGenerator.__init__(self, config)
+        self.values = [float(value) for value in config.get('values', [0.0, 0.5, 1.0, 0.5])]
+        if not self.values:
+            raise ValueError("The steps motion needs at least one value")
+        self.period = float(config.get('period', 1.0))
+        if self.period <= 0:
+            raise ValueError("The period of the steps motion must be positive, not %s" % self.period)
+
+    def bind(self, store):
+        self.lower = store.min
+        self.span = [upper - lower for lower, upper in zip(store.min, store.max)]
+        self.start = None
+
+    def positions(self, store, now, dt):
+        if self.start is None:
+            self.start = now
+        fraction = self.values[int((now - self.start) / self.period) % len(self.values)]
+        return array.array('d', [lower + fraction * span for lower, span in zip(self.lower, self.span)])
+
+
+PATTERNS = {
+    'triangle': TriangleSweep,
+    'sine': Sinusoid,
+    'random_walk': RandomWalk,
+    'steps': StepSequence,
+}
+
+
+def make_motion_generator(config):
+    # config is the motion parameter: a dictionary with the 'pattern' and
+    # its settings.
+    pattern = config.get('pattern', 'triangle')
+    if pattern not in PATTERNS:
+        raise ValueError("Unknown motion pattern '%s'" % pattern)
+    return PATTERNS[pattern](config)
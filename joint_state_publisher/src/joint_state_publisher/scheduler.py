@@ -0,0 +1,137 @@
+# Software License Agreement (BSD License)
+#
+# Copyright (c) 2010, Willow Garage, Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#
+#  * Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+#  * Redistributions in binary form must reproduce the above
+#    copyright notice, this list of conditions and the following
+#    disclaimer in the documentation and/or other materials provided
+#    with the distribution.
+#  * Neither the name of Willow Garage, Inc. nor the names of its
+#    contributors may be used to endorse or promote products derived
+#    from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+# FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+# COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+# INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+# BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+# LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+# CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+# ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+import time
+
+import rospy
+
+# Wall clock that is not affected by system time changes, where available.
+monotonic = getattr(time, 'monotonic', time.time)
+
+
+class Scheduler(object):
+    # Periodic scheduler for the publish loop.  Deadlines are computed from
+    # the start time rather than from the end of the previous sleep, so that
+    # the time spent publishing does not make the loop drift.  When a cycle
+    # overruns, the policy decides what happens to the deadlines that have
+    # already passed: 'skip' drops them and waits for the next one in the
+    # future, 'catch_up' runs the missed cycles back to back (for at most
+    # MAX_CATCH_UP periods) so that the average rate is preserved.
+    #
+    # A clock that can jump forwards, such as ROS time on /clock, is given
+    # with resync set: like rospy.Rate, a cycle found more than
+    # RESYNC_PERIODS late is then taken for a jump of the clock (e.g. the
+    # first /clock message of a simulation) rather than for missed
+    # deadlines, and the schedule starts over from there.  On the wall
+    # clock, every overrun counts as missed.
+
+    POLICIES = ('skip', 'catch_up')
+    MAX_CATCH_UP = 10
+    RESYNC_PERIODS = 100
+
+    def __init__(self, rate, policy='skip', clock=monotonic, sleep=time.sleep, resync=False):
+        if rate <= 0:
+            raise ValueError("The publish rate must be positive, got %s" % rate)
+        if policy not in self.POLICIES:
+            raise ValueError("Unknown deadline policy '%s', expected one of %s" %
+                             (policy, ', '.join(self.POLICIES)))
+        self.period = 1.0 / rate
+        self.policy = policy
+        self.clock = clock
+        self.sleep_fn = sleep
+        self.resync = resync
+
+        self.next_deadline = None
+        # Number of cycles run, number of deadlines that were reached late,
+        # the worst lateness seen, in seconds, and how often the schedule
+        # started over after the clock jumped.
+        self.ticks = 0
+        self.missed = 0
+        self.max_lateness = 0.0
+        self.resyncs = 0
+
+    @classmethod
+    def for_ros_time(cls, rate, policy='skip'):
+        # A scheduler that follows ROS time, so that it runs on /clock when
+        # use_sim_time is set.
+        return cls(rate, policy, clock=rospy.get_time, sleep=rospy.sleep, resync=True)
+
+    def start(self):
+        self.next_deadline = self.clock()
+
+    def sleep(self):
+        # Sleep until the deadline of the next cycle.
+        if self.next_deadline is None:
+            self.start()
+        self.ticks += 1
+        period = self.period
+        self.next_deadline += period
+        now = self.clock()
+
+        if now < self.next_deadline - 2 * period:
+            # The clock jumped backwards (e.g. a simulation was reset), so the
+            # deadlines are meaningless; start over from now.
+            rospy.logwarn("Clock moved backwards by %.3fs, restarting the schedule",
+                          self.next_deadline - period - now)
+            self.resyncs += 1
+            self.next_deadline = now + period
+
+        lateness = now - self.next_deadline
+        if lateness <= 0:
+            self._sleep(-lateness)
+            return
+
+        if self.resync and lateness > self.RESYNC_PERIODS * period:
+            rospy.logdebug("Clock moved forwards by %.3fs, restarting the schedule", lateness)
+            self.resyncs += 1
+            self.next_deadline = now + period
+            self._sleep(period)
+            return
+
+        self.max_lateness = max(self.max_lateness, lateness)
+        if self.policy == 'catch_up' and lateness < self.MAX_CATCH_UP * period:
+            # Run this cycle right away; the following ones catch up in turn.
+            self.missed += 1
+            return
+
+        # Drop every deadline that already passed and wait for the next one.
+        skipped = int(lateness / period) + 1
+        self.missed += skipped
+        self.next_deadline += skipped * period
+        self._sleep(self.next_deadline - now)
+
+    def _sleep(self, duration):
+        try:
+            self.sleep_fn(duration)
+        except rospy.exceptions.ROSTimeMovedBackwardsException:
+            # Picked up on the next call to sleep().
+            pass
@@ -0,0 +1,187 @@
+# Software License Agreement (BSD License)
+#
+# Copyright (c) 2010, Willow Garage, Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#
+#  * Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+#  * Redistributions in binary form must reproduce the above
+#    copyright notice, this list of conditions and the following
+#    disclaimer in the documentation and/or other materials provided
+#    with the distribution.
+#  * Neither the name of Willow Garage, Inc. nor the names of its
+#    contributors may be used to endorse or promote products derived
+#    from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+# FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+# COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+# INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+# BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+# LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+# CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+# ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+import bisect
+
+import yaml
+
+
+def _duration_to_sec(value):
+    # time_from_start as a message Duration, a {secs, nsecs} dictionary from
+    # YAML, or plain seconds.
+    if hasattr(value, 'to_sec'):
+        return value.to_sec()
+    if isinstance(value, dict):
+        return value.get('secs', 0) + value.get('nsecs', 0) * 1e-9
+    return float(value)
+
+
+class Trajectory(object):
+    # A joint trajectory as a list of waypoint times and, per waypoint, the
+    # positions (and optionally velocities) of all its joints.  Without
+    # velocities the joints move linearly between waypoints; with them,
+    # along cubic Hermite splines.  Accelerations are not used.
+
+    def __init__(self, joint_names, times, positions, velocities=None):
+        num = len(joint_names)
+        if not times:
+            raise ValueError("The trajectory has no points")
+        for i in range(len(times)):
+            if len(positions[i]) != num or (velocities is not None and len(velocities[i]) != num):
+                raise ValueError("Point %d of the trajectory does not have a value for each joint" % i)
+            if i > 0 and times[i] <= times[i - 1]:
+                raise ValueError("The times of the trajectory points are not increasing")
+        self.joint_names = list(joint_names)
+        self.times = list(times)
+        self.positions = [list(point) for point in positions]
+        if velocities is None:
+            self.velocities = None
+        else:
+            self.velocities = [list(point) for point in velocities]
+
+    @classmethod
+    def from_msg(cls, msg):
+        return cls.from_points(msg.joint_names, [(point.time_from_start, point.positions, point.velocities)
+                                                 for point in msg.points])
+
+    @classmethod
+    def from_yaml(cls, stream):
+        # The same layout as a trajectory_msgs/JointTrajectory in YAML, as
+        # printed by rostopic echo; time_from_start may also be in seconds.
+        data = yaml.safe_load(stream)
+        return cls.from_points(data['joint_names'], [(point['time_from_start'], point['positions'],
+                                                      point.get('velocities', []))
+                                                     for point in data['points']])
+
+    @classmethod
+    def from_points(cls, joint_names, points):
+        times = [_duration_to_sec(time_from_start) for time_from_start, positions, velocities in points]
+        positions = [positions for time_from_start, positions, velocities in points]
+        velocities = None
+        if points and all(velocities for time_from_start, positions, velocities in points):
+            velocities = [velocities for time_from_start, positions, velocities in points]
+        return cls(joint_names, times, positions, velocities)
+
+    def prepend(self, positions):
+        # Start from the given positions at time 0, if the first waypoint is
+        # later than that.
+        if self.times[0] <= 0:
+            return
+        self.times.insert(0, 0.0)
+        self.positions.insert(0, list(positions))
+        if self.velocities is not None:
+            self.velocities.insert(0, [0.0] * len(positions))
+
+    def duration(self):
+        return self.times[-1]
+
+    def sample(self, t):
+        # The positions and velocities of all joints at time t, evaluated for
+        # all joints at once from the segment that t falls in.
+        times = self.times
+        if t <= times[0]:
+            return self.positions[0], self._velocities_at(0)
+        if t >= times[-1]:
+            return self.positions[-1], [0.0] * len(self.joint_names)
+        i = bisect.bisect_right(times, t) - 1
+        h = times[i + 1] - times[i]
+        s = (t - times[i]) / h
+        p0 = self.positions[i]
+        p1 = self.positions[i + 1]
+        if self.velocities is None:
+            return ([a + (b - a) * s for a, b in zip(p0, p1)],
+                    [(b - a) / h for a, b in zip(p0, p1)])
+
+        v0 = self.velocities[i]
+        v1 = self.velocities[i + 1]
+        s2 = s * s
+        s3 = s2 * s
+        h00 = 2 * s3 - 3 * s2 + 1
+        h10 = (s3 - 2 * s2 + s) * h
+        h01 = -2 * s3 + 3 * s2
+        h11 = (s3 - s2) * h
+        d00 = (6 * s2 - 6 * s) / h
+        d10 = 3 * s2 - 4 * s + 1
+        d01 = -d00
+        d11 = 3 * s2 - 2 * s
+        return ([h00 * a + h10 * va + h01 * b + h11 * vb for a, b, va, vb in zip(p0, p1, v0, v1)],
+                [d00 * a + d10 * va + d01 * b + d11 * vb for a, b, va, vb in zip(p0, p1, v0, v1)])
+
+    def _velocities_at(self, i):
+        if self.velocities is None:
+            return [0.0] * len(self.joint_names)
+        return self.velocities[i]
+
+
+class TrajectoryPlayer(object):
+    # Plays a trajectory back against a clock.  A new trajectory replaces
+    # the one playing; it is swapped in as a single attribute, so play()
+    # may be called from another thread than sample().  A start of None
+    # starts the trajectory at the first sample() with a nonzero time, so
+    # that under use_sim_time it waits for the first /clock message.
+
+    def __init__(self):
+        self.playing = None
+
+    def play(self, trajectory, start, loop=False):
+        self.playing = (trajectory, start, loop)
+
+    def stop(self):
+        self.playing = None
+
+    def sample(self, now):
+        # Returns the trajectory and its positions and velocities at time
+        # now, or None when nothing is playing or the start is still ahead.
+        playing = self.playing
+        if playing is None:
+            return None
+        trajectory, start, loop = playing
+        if start is None:
+            if not now:
+                return None
+            start = now
+            anchored = (trajectory, start, loop)
+            if self.playing is playing:
+                self.playing = anchored
+            playing = anchored
+        t = now - start
+        if t < 0:
+            return None
+        duration = trajectory.duration()
+        if loop and duration > 0:
+            t %= duration
+        elif t >= duration:
+            # Hold the final point from now on, without evaluating it again.
+            if self.playing is playing:
+                self.playing = None
+        positions, velocities = trajectory.sample(t)
+        return trajectory, positions, velocities
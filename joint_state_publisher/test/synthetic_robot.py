@@ -0,0 +1,36 @@
+#!/usr/bin/env python
+import argparse
+
+
+def generate_urdf(num_joints, mimic_depth=0, mimic_fanout=1):
+    # A serial chain of num_joints revolute joints.  With a mimic_depth, the
+    # joints are grouped into one free joint followed by mimic_fanout chains
+    # of mimic_depth joints each, where every joint of a chain mimics the one
+    # before it (and the first one mimics the free joint).
+    group_size = 1 + mimic_fanout * mimic_depth
+    lines = ['<?xml version="1.0"?>', '<robot name="synthetic_%d_joint_robot">' % num_joints]
+    for i in range(num_joints + 1):
+        lines.append('  <link name="link_%d"/>' % i)
+    for i in range(num_joints):
+        lines.append('  <joint name="j_%d" type="revolute">' % i)
+        lines.append('    <parent link="link_%d"/>' % i)
+        lines.append('    <child link="link_%d"/>' % (i + 1))
+        lines.append('    <axis xyz="0 0 1"/>')
+        position = i % group_size if mimic_depth else 0
+        if position:
+            level = (position - 1) % mimic_depth
+            parent = i - position if level == 0 else i - 1
+            lines.append('    <mimic joint="j_%d" multiplier="0.5" offset="0.1"/>' % parent)
+        lines.append('    <limit effort="10" velocity="10" lower="-1" upper="1"/>')
+        lines.append('  </joint>')
+    lines.append('</robot>')
+    return '\n'.join(lines) + '\n'
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Print a synthetic URDF with the given number of joints.')
+    parser.add_argument('num_joints', type=int)
+    parser.add_argument('--mimic-depth', type=int, default=0)
+    parser.add_argument('--mimic-fanout', type=int, default=1)
+    args = parser.parse_args()
+    print(generate_urdf(args.num_joints, args.mimic_depth, args.mimic_fanout))
@@ -0,0 +1,121 @@
+#!/usr/bin/env python
+import unittest
+
+from joint_state_publisher.arbitration import SourceArbiter, parse_source_list
+from joint_state_publisher.joint_store import JointStore, SourceMapping
+
+
+class ArbitrationTestCase(unittest.TestCase):
+    def make_arbiter(self, source_list):
+        store = JointStore([('a', {'position': 0.0, 'zero': 0.5}),
+                            ('b', {'position': 0.0, 'zero': -0.5})])
+        arbiter = SourceArbiter(store, parse_source_list(source_list))
+        self.mapping = SourceMapping(store, ['a'])
+        return arbiter
+
+    def send(self, arbiter, source, position, stamp, now):
+        arbiter.apply(source, self.mapping, [('position', [position])], stamp, now)
+        arbiter.expire(now)
+
+    def test_priority_override(self):
+        arbiter = self.make_arbiter([{'topic': 'low', 'priority': 0},
+                                     {'topic': 'high', 'priority': 1}])
+        self.send(arbiter, 1, 2.0, 1.0, 1.0)
+        self.send(arbiter, 0, 1.0, 2.0, 2.0)
+        # A newer message of a lower priority source does not take over.
+        self.assertEqual(2.0, arbiter.store.position[0])
+        self.assertEqual(1, arbiter.owner[0])
+        # While the joints it does not send stay untouched.
+        self.assertEqual(0.0, arbiter.store.position[1])
+
+    def test_same_priority_stamp(self):
+        arbiter = self.make_arbiter(['first', 'second'])
+        self.send(arbiter, 0, 1.0, 5.0, 1.0)
+        # Among sources of the same priority, an older stamp loses even when
+        # it arrives later.
+        self.send(arbiter, 1, 2.0, 4.0, 2.0)
+        self.assertEqual(1.0, arbiter.store.position[0])
+        self.send(arbiter, 1, 3.0, 6.0, 3.0)
+        self.assertEqual(3.0, arbiter.store.position[0])
+        self.assertEqual(1, arbiter.owner[0])
+
+    def test_fallback_to_lower_priority(self):
+        arbiter = self.make_arbiter([{'topic': 'low', 'priority': 0},
+                                     {'topic': 'high', 'priority': 1, 'timeout': 1.0}])
+        self.send(arbiter, 0, 1.0, 0.0, 0.0)
+        self.send(arbiter, 1, 2.0, 0.5, 0.5)
+        self.assertEqual(2.0, arbiter.store.position[0])
+        self.assertEqual(1.5, arbiter.next_deadline())
+        arbiter.expire(1.4)
+        self.assertEqual(2.0, arbiter.store.position[0])
+        arbiter.expire(1.5)
+        self.assertEqual(1.0, arbiter.store.position[0])
+        self.assertEqual(0, arbiter.owner[0])
+        # The low priority source never goes stale, so there is nothing left
+        # to wait on.
+        self.assertEqual(None, arbiter.next_deadline())
+
+    def test_fallback_to_zero(self):
+        arbiter = self.make_arbiter([{'topic': 'only', 'timeout': 1.0}])
+        self.send(arbiter, 0, 1.0, 0.0, 0.0)
+        arbiter.expire(0.5)
+        self.assertEqual(1.0, arbiter.store.position[0])
+        arbiter.expire(1.0)
+        self.assertEqual(0.5, arbiter.store.position[0])
+        self.assertEqual(SourceArbiter.UNOWNED, arbiter.owner[0])
+        self.assertEqual(None, arbiter.next_deadline())
+        # Fresh data takes the joint back.
+        self.send(arbiter, 0, 3.0, 2.0, 2.0)
+        self.assertEqual(3.0, arbiter.store.position[0])
+
+    def test_refresh_postpones_timeout(self):
+        arbiter = self.make_arbiter([{'topic': 'only', 'timeout': 1.0}])
+        self.send(arbiter, 0, 1.0, 0.0, 0.0)
+        self.send(arbiter, 0, 2.0, 0.8, 0.8)
+        arbiter.expire(1.5)
+        self.assertEqual(2.0, arbiter.store.position[0])
+        arbiter.expire(1.8)
+        self.assertEqual(0.5, arbiter.store.position[0])
+
+    def test_timed_source_taken_over_by_untimed(self):
+        arbiter = self.make_arbiter([{'topic': 'timed', 'priority': 0, 'timeout': 1.0},
+                                     {'topic': 'untimed', 'priority': 1}])
+        self.send(arbiter, 0, 1.0, 0.0, 0.0)
+        self.send(arbiter, 1, 2.0, 0.5, 0.5)
+        # The deadline set for the timed source comes up while the joint
+        # follows a source that never goes stale; it is dropped.
+        arbiter.expire(2.0)
+        self.assertEqual(2.0, arbiter.store.position[0])
+        self.assertEqual(1, arbiter.owner[0])
+        self.assertEqual(None, arbiter.next_deadline())
+        arbiter.expire(100.0)
+        self.assertEqual(2.0, arbiter.store.position[0])
+
+    def test_untimed_source_taken_over_by_timed(self):
+        arbiter = self.make_arbiter([{'topic': 'untimed', 'priority': 0},
+                                     {'topic': 'timed', 'priority': 1, 'timeout': 1.0}])
+        self.send(arbiter, 0, 1.0, 0.0, 0.0)
+        self.send(arbiter, 1, 2.0, 0.5, 0.5)
+        arbiter.expire(1.5)
+        self.assertEqual(1.0, arbiter.store.position[0])
+        self.assertEqual(0, arbiter.owner[0])
+
+    def test_new_owner_with_shorter_timeout(self):
+        arbiter = self.make_arbiter([{'topic': 'slow', 'priority': 0, 'timeout': 10.0},
+                                     {'topic': 'fast', 'priority': 1, 'timeout': 0.1}])
+        self.send(arbiter, 0, 1.0, 0.0, 0.0)
+        self.send(arbiter, 1, 2.0, 1.0, 1.0)
+        # The joint waits on the deadline of its new owner, not on the one
+        # of the source it followed before.
+        self.assertAlmostEqual(1.1, arbiter.next_deadline())
+        arbiter.expire(1.2)
+        self.assertEqual(1.0, arbiter.store.position[0])
+        self.assertEqual(0, arbiter.owner[0])
+        arbiter.expire(10.0)
+        self.assertEqual(0.5, arbiter.store.position[0])
+        self.assertEqual(None, arbiter.next_deadline())
+
+
+if __name__ == '__main__':
+    import rostest
+    rostest.rosrun('joint_state_publisher', 'test_arbitration', ArbitrationTestCase)
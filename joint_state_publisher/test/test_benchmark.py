@@ -0,0 +1,112 @@
+#!/usr/bin/env python
+import gc
+import json
+import os
+import resource
+import time
+import unittest
+
+import rospkg
+import rospy
+
+import joint_state_publisher
+
+from synthetic_robot import generate_urdf
+
+try:
+    import tracemalloc
+except ImportError:
+    tracemalloc = None
+
+try:
+    process_time = time.process_time
+except AttributeError:
+    process_time = time.clock
+
+
+def measure(case, ticks):
+    # Construct a JointStatePublisher for a synthetic robot and time the
+    # parse and the publish cycles.
+    rospy.set_param('~robot_description', generate_urdf(case['joints'],
+                                                        case.get('mimic_depth', 0),
+                                                        case.get('mimic_fanout', 1)))
+    gc.collect()
+    maxrss = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    start = time.time()
+    jsp = joint_state_publisher.JointStatePublisher()
+    init_time = time.time() - start
+    maxrss_growth = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss - maxrss
+    # Do not let collecting the garbage left over by the parse count against
+    # the first cycles.
+    gc.collect()
+
+    tick_times = []
+    cpu_start = process_time()
+    for _ in range(ticks):
+        start = time.time()
+        jsp.update(0.001)
+        jsp.publish_joint_states()
+        tick_times.append(time.time() - start)
+    cpu_per_tick = (process_time() - cpu_start) / ticks
+    tick_times.sort()
+    mean_tick = sum(tick_times) / ticks
+    p99_tick = tick_times[min(ticks - 1, int(ticks * 0.99))]
+
+    # Tracing allocations slows everything down for a while, even after it
+    # is stopped, so the memory use is measured on a second instance.
+    memory = peak_memory = None
+    if tracemalloc is not None:
+        del jsp
+        gc.collect()
+        tracemalloc.start()
+        jsp = joint_state_publisher.JointStatePublisher()
+        memory, peak_memory = tracemalloc.get_traced_memory()
+        tracemalloc.stop()
+
+    return {
+        'name': case['name'],
+        'joints': case['joints'],
+        'mimic_depth': case.get('mimic_depth', 0),
+        'mimic_fanout': case.get('mimic_fanout', 1),
+        'init_time': init_time,
+        'memory': memory,
+        'peak_memory': peak_memory,
+        'maxrss_growth_kb': maxrss_growth,
+        'mean_tick': mean_tick,
+        'p99_tick': p99_tick,
+        'cpu_per_tick': cpu_per_tick,
+        # The rate at which 99% of the cycles still fit in their period.
+        'max_rate': 1.0 / p99_tick if p99_tick > 0 else float('inf'),
+    }
+
+
+class BenchmarkTestCase(unittest.TestCase):
+    def test_benchmark(self):
+        rospy.init_node('test_benchmark', anonymous=True)
+        cases = rospy.get_param('~cases')
+        ticks = rospy.get_param('~ticks', 200)
+        # By default next to the test results, rather than wherever the
+        # test happens to be run from.
+        output_file = rospy.get_param('~output_file', os.path.join(
+            rospkg.get_test_results_dir(), 'joint_state_publisher', 'benchmark.json'))
+        directory = os.path.dirname(output_file)
+        if directory and not os.path.isdir(directory):
+            os.makedirs(directory)
+
+        results = [measure(case, ticks) for case in cases]
+        with open(output_file, 'w') as f:
+            json.dump(results, f, indent=2, sort_keys=True)
+        rospy.loginfo("Benchmark results written to %s", output_file)
+
+        for case, result in zip(cases, results):
+            if 'max_init_time' in case:
+                self.assertLessEqual(result['init_time'], case['max_init_time'],
+                                     "%s: parsing took %.3fs" % (case['name'], result['init_time']))
+            if 'min_rate' in case:
+                self.assertGreaterEqual(result['max_rate'], case['min_rate'],
+                                        "%s: sustains only %.0f Hz" % (case['name'], result['max_rate']))
+
+
+if __name__ == '__main__':
+    import rostest
+    rostest.rosrun('joint_state_publisher', 'test_benchmark', BenchmarkTestCase)
@@ -0,0 +1,178 @@
+#!/usr/bin/env python
+import math
+import os
+import unittest
+import xml.dom.minidom
+
+from joint_state_publisher import JointStatePublisher, JointTable
+from joint_state_publisher.description import extract_urdf_joints
+
+from synthetic_robot import generate_urdf
+
+TEST_URDFS = ('64_joint_robot.urdf', 'mimic_chain.urdf', 'mimic_cycle.urdf', 'multi_joint_robot.urdf',
+              'slash_fiction.urdf', 'zero_joint_robot.urdf')
+
+# Joints of every kind the parser treats differently, some of them nested
+# where they must be ignored.
+MIXED_URDF = """<?xml version="1.0"?>
+<robot name="mixed">
+  <link name="base"/>
+  <joint name="fixed" type="fixed"/>
+  <joint name="floating" type="floating"/>
+  <joint name="wheel" type="continuous"/>
+  <joint name="no_limits" type="revolute"/>
+  <joint name="soft" type="prismatic">
+    <limit lower="-1" upper="2"/>
+    <safety_controller soft_lower_limit="-0.5" soft_upper_limit="1.5"/>
+  </joint>
+  <joint name="two_safety" type="revolute">
+    <limit lower="-1" upper="1"/>
+    <safety_controller soft_lower_limit="-0.5"/>
+    <safety_controller soft_upper_limit="0.5"/>
+  </joint>
+  <joint name="offset" type="revolute">
+    <limit lower="0.5" upper="1.5"/>
+  </joint>
+  <joint name="follower" type="revolute">
+    <limit lower="-1" upper="1"/>
+    <mimic joint="soft" multiplier="2" offset="0.1"/>
+  </joint>
+  <joint name="bare_follower" type="revolute">
+    <limit lower="-1" upper="1"/>
+    <mimic joint="wheel"/>
+  </joint>
+  <gazebo>
+    <joint name="nested" type="revolute"><limit lower="-1" upper="1"/></joint>
+  </gazebo>
+</robot>
+"""
+
+
+def minidom_joints(description, use_small, use_mimic, zeros):
+    # The DOM-based parsing that extract_urdf_joints() replaced, kept to
+    # check that the streaming parser gives the same joints.
+    joint_list = []
+    free_joints = {}
+    dependent_joints = {}
+    robot = xml.dom.minidom.parseString(description).getElementsByTagName('robot')[0]
+    for child in robot.childNodes:
+        if child.nodeType is child.TEXT_NODE:
+            continue
+        if child.localName == 'joint':
+            jtype = child.getAttribute('type')
+            if jtype in ['fixed', 'floating', 'planar']:
+                continue
+            name = child.getAttribute('name')
+            joint_list.append(name)
+            if jtype == 'continuous':
+                minval = -math.pi
+                maxval = math.pi
+            else:
+                try:
+                    limit = child.getElementsByTagName('limit')[0]
+                    minval = float(limit.getAttribute('lower'))
+                    maxval = float(limit.getAttribute('upper'))
+                except (IndexError, ValueError):
+                    continue
+
+            safety_tags = child.getElementsByTagName('safety_controller')
+            if use_small and len(safety_tags) == 1:
+                tag = safety_tags[0]
+                if tag.hasAttribute('soft_lower_limit'):
+                    minval = max(minval, float(tag.getAttribute('soft_lower_limit')))
+                if tag.hasAttribute('soft_upper_limit'):
+                    maxval = min(maxval, float(tag.getAttribute('soft_upper_limit')))
+
+            mimic_tags = child.getElementsByTagName('mimic')
+            if use_mimic and len(mimic_tags) == 1:
+                tag = mimic_tags[0]
+                entry = {'parent': tag.getAttribute('joint')}
+                if tag.hasAttribute('multiplier'):
+                    entry['factor'] = float(tag.getAttribute('multiplier'))
+                if tag.hasAttribute('offset'):
+                    entry['offset'] = float(tag.getAttribute('offset'))
+
+                dependent_joints[name] = entry
+                continue
+
+            if name in dependent_joints:
+                continue
+
+            zeroval = zeros.get(name)
+            if not zeroval:
+                if minval > 0 or maxval < 0:
+                    zeroval = (maxval + minval)/2
+                else:
+                    zeroval = 0
+
+            joint = {'min': minval, 'max': maxval, 'zero': zeroval, 'position': zeroval}
+            if jtype == 'continuous':
+                joint['continuous'] = True
+            free_joints[name] = joint
+    return joint_list, free_joints, dependent_joints
+
+
+class UrdfParser(JointStatePublisher):
+    # Just enough of a JointStatePublisher to run init_urdf().
+    def __init__(self, use_small, use_mimic, zeros):
+        self.use_small = use_small
+        self.use_mimic = use_mimic
+        self.zeros = zeros
+        self.pub_def_positions = True
+        self.pub_def_vels = False
+        self.pub_def_efforts = False
+
+    def get_param(self, name, value=None):
+        if name.startswith('zeros/'):
+            return self.zeros.get(name[len('zeros/'):], value)
+        return value
+
+    def joints(self, description):
+        table = JointTable()
+        self.init_urdf(table, extract_urdf_joints(description))
+        return table.joint_list, table.free_joints, table.dependent_joints
+
+
+class DescriptionTestCase(unittest.TestCase):
+    def assert_same_joints(self, description, label, zeros={}):
+        for use_small in (True, False):
+            for use_mimic in (True, False):
+                expected = minidom_joints(description, use_small, use_mimic, zeros)
+                actual = UrdfParser(use_small, use_mimic, zeros).joints(description)
+                context = "%s, use_smallest_joint_limits %s, use_mimic_tags %s" % (label, use_small, use_mimic)
+                self.assertEqual(expected[0], actual[0], "joint_list of " + context)
+                self.assertEqual(expected[1], actual[1], "free_joints of " + context)
+                self.assertEqual(expected[2], actual[2], "dependent_joints of " + context)
+
+    def test_test_urdfs(self):
+        directory = os.path.dirname(os.path.abspath(__file__))
+        for name in TEST_URDFS:
+            with open(os.path.join(directory, name)) as f:
+                self.assert_same_joints(f.read(), name)
+
+    def test_slash_fiction_zeros(self):
+        # slash_fiction.urdf nests its <robot> in <urdf>, and has a joint
+        # name with a slash in it.
+        directory = os.path.dirname(os.path.abspath(__file__))
+        with open(os.path.join(directory, 'slash_fiction.urdf')) as f:
+            description = f.read()
+        zeros = {'standard_name': 0.42, 'kirk/spock': 0.42}
+        self.assert_same_joints(description, 'slash_fiction.urdf', zeros)
+        joint_list, free_joints, _ = UrdfParser(True, True, zeros).joints(description)
+        self.assertEqual(['standard_name', 'kirk/spock'], joint_list)
+        self.assertEqual(0.42, free_joints['kirk/spock']['zero'])
+
+    def test_mixed_joints(self):
+        self.assert_same_joints(MIXED_URDF, 'mixed joints')
+        joint_list, _, _ = UrdfParser(True, True, {}).joints(MIXED_URDF)
+        self.assertNotIn('nested', joint_list)
+
+    def test_synthetic_robots(self):
+        for joints, depth, fanout in ((50, 0, 1), (200, 3, 2), (500, 6, 3)):
+            self.assert_same_joints(generate_urdf(joints, depth, fanout),
+                                    "synthetic robot (%d, %d, %d)" % (joints, depth, fanout))
+
+
+if __name__ == '__main__':
+    import rostest
+    rostest.rosrun('joint_state_publisher', 'test_description', DescriptionTestCase)
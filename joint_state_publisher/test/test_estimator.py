@@ -0,0 +1,76 @@
+#!/usr/bin/env python
+import unittest
+
+from joint_state_publisher.estimator import PositionEstimator
+from joint_state_publisher.joint_store import JointStore, SourceMapping
+
+
+class EstimatorTestCase(unittest.TestCase):
+    def setUp(self):
+        self.store = JointStore([('a', {'position': 0.0, 'min': -10.0, 'max': 10.0}),
+                                 ('b', {'position': 0.0, 'min': -10.0, 'max': 10.0})])
+        self.mapping = SourceMapping(self.store, ['a'])
+
+    def record(self, estimator, stamp, position, velocity=None):
+        # Like a source message: the store takes the position, and the
+        # estimator the sample.
+        self.store.position[0] = position
+        estimator.record(self.mapping, stamp, [position], [] if velocity is None else [velocity])
+
+    def test_interpolation(self):
+        estimator = PositionEstimator(self.store, 0.1)
+        self.record(estimator, 1.0, 1.0)
+        self.record(estimator, 2.0, 3.0)
+        # Publishing at a time between the two samples.
+        estimated = estimator.estimate(self.store.position, 1.25)
+        self.assertAlmostEqual(1.5, estimated[0])
+        # Before the older sample, it is held.
+        self.assertAlmostEqual(1.0, estimator.estimate(self.store.position, 0.5)[0])
+        # Joints without samples are left alone.
+        self.assertEqual(0.0, estimated[1])
+
+    def test_extrapolation_from_samples(self):
+        estimator = PositionEstimator(self.store, 1.0)
+        self.record(estimator, 1.0, 1.0)
+        # A single sample without a velocity is not extrapolated.
+        self.assertAlmostEqual(1.0, estimator.estimate(self.store.position, 1.5)[0])
+        self.record(estimator, 2.0, 3.0)
+        self.assertAlmostEqual(4.0, estimator.estimate(self.store.position, 2.5)[0])
+
+    def test_extrapolation_from_velocity(self):
+        estimator = PositionEstimator(self.store, 1.0)
+        self.record(estimator, 1.0, 1.0, 0.5)
+        self.assertAlmostEqual(1.25, estimator.estimate(self.store.position, 1.5)[0])
+
+    def test_max_extrapolation(self):
+        estimator = PositionEstimator(self.store, 0.1)
+        self.record(estimator, 1.0, 1.0, 2.0)
+        self.assertAlmostEqual(1.1, estimator.estimate(self.store.position, 1.05)[0])
+        # However far ahead, at most max_extrapolation seconds are added.
+        self.assertAlmostEqual(1.2, estimator.estimate(self.store.position, 5.0)[0])
+
+    def test_out_of_order_sample(self):
+        estimator = PositionEstimator(self.store, 1.0)
+        self.record(estimator, 1.0, 1.0)
+        self.record(estimator, 2.0, 2.0)
+        # An older sample does not replace the newer one.
+        estimator.record(self.mapping, 1.5, [9.0], [])
+        self.assertAlmostEqual(2.5, estimator.estimate(self.store.position, 2.5)[0])
+
+    def test_other_writer(self):
+        estimator = PositionEstimator(self.store, 1.0)
+        self.record(estimator, 1.0, 1.0, 1.0)
+        # Something other than the sources (such as the GUI) moved the joint
+        # since; its value is published as is.
+        self.store.position[0] = 5.0
+        self.assertEqual(5.0, estimator.estimate(self.store.position, 1.5)[0])
+
+    def test_estimated_joints(self):
+        estimator = PositionEstimator(self.store, 1.0, ['b'])
+        self.record(estimator, 1.0, 1.0, 1.0)
+        self.assertEqual(1.0, estimator.estimate(self.store.position, 1.5)[0])
+
+
+if __name__ == '__main__':
+    import rostest
+    rostest.rosrun('joint_state_publisher', 'test_estimator', EstimatorTestCase)
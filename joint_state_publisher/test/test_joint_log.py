@@ -0,0 +1,126 @@
+#!/usr/bin/env python
+import os
+import shutil
+import tempfile
+import unittest
+
+import rospy
+
+from sensor_msgs.msg import JointState
+
+from joint_state_publisher.joint_log import JointLogReader, JointLogReplayer, JointLogWriter
+
+
+def make_state(stamp, names, position, velocity=()):
+    msg = JointState()
+    msg.header.stamp = rospy.Time.from_sec(stamp)
+    msg.name = names
+    msg.position = list(position)
+    msg.velocity = list(velocity)
+    return msg
+
+
+class JointLogTestCase(unittest.TestCase):
+    def setUp(self):
+        self.directory = tempfile.mkdtemp()
+        self.path = os.path.join(self.directory, 'joint_states.log')
+
+    def tearDown(self):
+        shutil.rmtree(self.directory)
+
+    def write(self, messages):
+        writer = JointLogWriter(self.path)
+        for msg in messages:
+            writer.write(msg)
+        writer.close()
+
+    def read_all(self, reader):
+        frames = []
+        while reader.peek_stamp() is not None:
+            frames.append(reader.read())
+        return frames
+
+    def test_round_trip(self):
+        names = ['a', 'b']
+        self.write([make_state(1.0 + i, names, [i, -i], [0.5, 0.25]) for i in range(5)])
+        reader = JointLogReader(self.path)
+        frames = self.read_all(reader)
+        self.assertEqual([1.0, 2.0, 3.0, 4.0, 5.0], [stamp for stamp, _, _ in frames])
+        stamp, frame_names, frame = frames[3]
+        self.assertEqual(names, frame_names)
+        self.assertEqual([3.0, -3.0], list(frame['position']))
+        self.assertEqual([0.5, 0.25], list(frame['velocity']))
+        self.assertNotIn('effort', frame)
+
+        # Reading again after a rewind gives the same frames.
+        reader.rewind()
+        self.assertEqual(frames[0][0], self.read_all(reader)[0][0])
+        reader.close()
+
+    def test_layout_change(self):
+        # The joints, and which fields are present, change half way.
+        first = ['a', 'b']
+        second = ['a', 'b', 'c']
+        self.write([make_state(1.0, first, [1.0, 2.0]),
+                    make_state(2.0, first, [1.5, 2.5]),
+                    make_state(3.0, second, [3.0, 4.0, 5.0], [0.1, 0.2, 0.3]),
+                    make_state(4.0, second, [3.5, 4.5, 5.5], [0.1, 0.2, 0.3])])
+        frames = self.read_all(JointLogReader(self.path))
+        self.assertEqual(4, len(frames))
+        self.assertEqual(first, frames[1][1])
+        self.assertEqual([1.5, 2.5], list(frames[1][2]['position']))
+        self.assertNotIn('velocity', frames[1][2])
+        self.assertEqual(second, frames[2][1])
+        self.assertEqual([3.5, 4.5, 5.5], list(frames[3][2]['position']))
+        self.assertEqual([0.1, 0.2, 0.3], list(frames[3][2]['velocity']))
+
+    def test_truncated_log(self):
+        first = make_state(1.0, ['a', 'b'], [1.0, 2.0])
+        self.write([first])
+        first_size = os.path.getsize(self.path)
+        self.write([first, make_state(2.0, ['a', 'b', 'c'], [1.0, 2.0, 3.0])])
+        with open(self.path, 'rb') as f:
+            data = f.read()
+        # Wherever the recording was cut short, in a layout or in a frame,
+        # the complete frames before the cut are read back and the rest is
+        # taken for the end.
+        for length in range(len(data) - 1, len(b'JSPLOG\x01'), -1):
+            with open(self.path, 'wb') as f:
+                f.write(data[:length])
+            reader = JointLogReader(self.path)
+            frames = self.read_all(reader)
+            reader.close()
+            self.assertEqual(1 if length >= first_size else 0, len(frames), "cut at %d bytes" % length)
+
+    def test_replay_rate(self):
+        names = ['a']
+        self.write([make_state(10.0 + i, names, [float(i)]) for i in range(10)])
+        replayer = JointLogReplayer(JointLogReader(self.path), rate=2.0)
+        # Nothing is due while the time is zero, as before the first /clock
+        # message under use_sim_time.
+        self.assertIsNone(replayer.sample(0.0))
+        self.assertEqual(10.0, replayer.sample(100.0)[0])
+        # At twice the rate, one second later the log is two seconds on,
+        # and only the newest frame due is returned.
+        self.assertEqual(12.0, replayer.sample(101.0)[0])
+        self.assertIsNone(replayer.sample(101.1))
+        stamp, frame_names, frame = replayer.sample(102.0)
+        self.assertEqual(14.0, stamp)
+        self.assertEqual([4.0], list(frame['position']))
+        # Past the end, the replay finishes.
+        self.assertEqual(19.0, replayer.sample(110.0)[0])
+        self.assertIsNone(replayer.sample(111.0))
+        self.assertTrue(replayer.finished)
+
+    def test_replay_loop(self):
+        names = ['a']
+        self.write([make_state(float(i), names, [float(i)]) for i in range(1, 4)])
+        replayer = JointLogReplayer(JointLogReader(self.path), loop=True)
+        stamps = [replayer.sample(100.0 + t) for t in (0.0, 1.0, 2.0, 3.0, 4.0, 5.0)]
+        self.assertEqual([1.0, 2.0, 3.0, 1.0, 2.0, 3.0], [sample[0] for sample in stamps])
+        self.assertFalse(replayer.finished)
+
+
+if __name__ == '__main__':
+    import rostest
+    rostest.rosrun('joint_state_publisher', 'test_joint_log', JointLogTestCase)
@@ -0,0 +1,72 @@
+#!/usr/bin/env python
+import os
+import unittest
+
+import rospy
+
+from rosgraph_msgs.msg import Clock
+from sensor_msgs.msg import JointState
+
+import joint_state_publisher
+
+PARAMS = ('lockstep', 'lockstep_ticks', 'source_list')
+
+
+class LockstepTestCase(unittest.TestCase):
+    @classmethod
+    def setUpClass(cls):
+        rospy.init_node('test_lockstep', anonymous=True)
+        with open(os.path.join(os.path.dirname(__file__), 'multi_joint_robot.urdf')) as f:
+            cls.description = f.read()
+
+    def make_publisher(self, **params):
+        rospy.set_param('~robot_description', self.description)
+        for name in PARAMS:
+            if rospy.has_param('~' + name):
+                rospy.delete_param('~' + name)
+        for name, value in params.items():
+            rospy.set_param('~' + name, value)
+        jsp = joint_state_publisher.JointStatePublisher()
+        # Keep what would have been published, as the message is reused.
+        self.published = []
+        jsp.publish_msg = lambda msg: self.published.append((msg.header.stamp.to_sec(), list(msg.position)))
+        return jsp
+
+    def test_clock(self):
+        jsp = self.make_publisher(lockstep='clock', lockstep_ticks=2)
+        for tick in range(1, 8):
+            jsp.clock_cb(Clock(clock=rospy.Time.from_sec(tick * 0.5)))
+        jsp.drain_lockstep(0.0)
+        # One message for every second tick, stamped with that tick.
+        self.assertEqual([1.0, 2.0, 3.0], [stamp for stamp, _ in self.published])
+        jsp.drain_lockstep(0.0)
+        self.assertEqual(3, len(self.published))
+        jsp.clock_cb(Clock(clock=rospy.Time.from_sec(4.0)))
+        jsp.drain_lockstep(0.0)
+        self.assertEqual(4.0, self.published[-1][0])
+
+    def test_source(self):
+        jsp = self.make_publisher(lockstep='source', source_list=['lockstep_source'])
+        for step in range(1, 6):
+            msg = JointState()
+            msg.header.stamp = rospy.Time.from_sec(10.0 + step)
+            msg.name = ['j12']
+            msg.position = [step * 0.1]
+            jsp.source_cb(msg, 0)
+        # Nothing is taken in before its step is published.
+        self.assertEqual(0.0, jsp.store.position[jsp.store.slots['j12']])
+        jsp.drain_lockstep(0.0)
+        # Every message gets a step of its own, stamped with the message,
+        # even though they all arrived before the first one was published.
+        self.assertEqual([11.0, 12.0, 13.0, 14.0, 15.0], [stamp for stamp, _ in self.published])
+        for step, (stamp, position) in enumerate(self.published, 1):
+            self.assertAlmostEqual(step * 0.1, position[0])
+            self.assertEqual(0.0, position[1])
+
+    def test_ticks_validated(self):
+        self.assertRaises(ValueError, self.make_publisher, lockstep='clock', lockstep_ticks=0)
+
+
+if __name__ == '__main__':
+    import rostest
+    rostest.rosrun('joint_state_publisher', 'test_lockstep', LockstepTestCase)
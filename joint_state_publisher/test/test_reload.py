@@ -0,0 +1,82 @@
+#!/usr/bin/env python
+import os
+import unittest
+
+import rospy
+
+import joint_state_publisher
+
+
+def read_urdf(name):
+    with open(os.path.join(os.path.dirname(__file__), name)) as f:
+        return f.read()
+
+
+class ReloadTestCase(unittest.TestCase):
+    @classmethod
+    def setUpClass(cls):
+        rospy.init_node('test_reload', anonymous=True)
+
+    def setUp(self):
+        rospy.set_param('~robot_description', read_urdf('multi_joint_robot.urdf'))
+        self.jsp = joint_state_publisher.JointStatePublisher()
+        self.published = []
+        self.jsp.publish_msg = lambda msg: self.published.append((list(msg.name), list(msg.position)))
+        self.reloads = []
+        self.jsp.set_reload_cb(lambda: self.reloads.append(list(self.jsp.joint_list)))
+
+    def test_values_kept(self):
+        jsp = self.jsp
+        jsp.free_joints['j12']['position'] = 0.3
+        jsp.free_joints['j23']['position'] = -0.2
+        # In mimic_chain.urdf, j12 is still free while j23 now mimics it,
+        # and j34 is new.
+        jsp.queue_description(read_urdf('mimic_chain.urdf'))
+        jsp.publish_joint_states()
+        self.assertEqual([['j12', 'j23', 'j34']], self.reloads)
+        self.assertEqual((['j12', 'j23', 'j34'], [0.3, 0.3, 0.3]), self.published[-1])
+        # Writes through the new joint views reach what gets published.
+        jsp.free_joints['j12']['position'] = 0.5
+        jsp.publish_joint_states()
+        self.assertEqual([0.5, 0.5, 0.5], self.published[-1][1])
+
+    def test_same_description(self):
+        table = self.jsp.table
+        self.jsp.queue_description(read_urdf('multi_joint_robot.urdf') + '\n')
+        self.jsp.publish_joint_states()
+        # Nothing that matters changed, so the joints stay as they are.
+        self.assertIs(table, self.jsp.table)
+        self.assertEqual([], self.reloads)
+
+    def test_mimic_cycle_rejected(self):
+        jsp = self.jsp
+        table = jsp.table
+        jsp.free_joints['j12']['position'] = 0.3
+        jsp.queue_description(read_urdf('mimic_cycle.urdf'))
+        jsp.publish_joint_states()
+        self.assertIs(table, jsp.table)
+        self.assertEqual([], self.reloads)
+        self.assertEqual((['j12', 'j23'], [0.3, 0.0]), self.published[-1])
+        # A later, valid description is still switched to.
+        jsp.queue_description(read_urdf('mimic_chain.urdf'))
+        jsp.publish_joint_states()
+        self.assertEqual(['j12', 'j23', 'j34'], self.published[-1][0])
+
+    def test_unparsable_rejected(self):
+        table = self.jsp.table
+        self.jsp.queue_description('<robot')
+        self.jsp.publish_joint_states()
+        self.assertIs(table, self.jsp.table)
+        self.assertEqual(['j12', 'j23'], self.published[-1][0])
+
+    def test_newest_description_wins(self):
+        # Two descriptions arriving before the publish loop gets to them.
+        self.jsp.queue_description(read_urdf('slash_fiction.urdf'))
+        self.jsp.queue_description(read_urdf('mimic_chain.urdf'))
+        self.jsp.publish_joint_states()
+        self.assertEqual([['j12', 'j23', 'j34']], self.reloads)
+
+
+if __name__ == '__main__':
+    import rostest
+    rostest.rosrun('joint_state_publisher', 'test_reload', ReloadTestCase)
@@ -0,0 +1,36 @@
+#!/usr/bin/env python
+import unittest
+
+import rospy
+
+from sensor_msgs.msg import JointState
+
+
+class TrajectoryPlaybackTestCase(unittest.TestCase):
+    def test_trajectory_playback(self):
+        rospy.init_node('test_trajectory_playback', anonymous=True)
+        self.positions = []
+        rospy.Subscriber('/joint_states', JointState, self.callback_state)
+        timeout = rospy.Time.now() + rospy.Duration(30.0)
+        while not (self.positions and self.positions[-1][0] == 1.0) and rospy.Time.now() < timeout:
+            rospy.sleep(0.1)
+
+        # j12 should end up on the last point of the trajectory, with the
+        # joints mimicking it following along.
+        self.assertEqual([1.0, 1.0, 1.0], self.positions[-1])
+
+        # Along the way, it should have passed through the points in between
+        # rather than jumping to the end.
+        self.assertTrue(any(0.0 < position[0] < 0.5 for position in self.positions))
+        self.assertTrue(any(0.5 < position[0] < 1.0 for position in self.positions))
+        # And it should never move backwards along the way.
+        moves = [b[0] - a[0] for a, b in zip(self.positions, self.positions[1:])]
+        self.assertTrue(all(move >= 0.0 for move in moves))
+
+    def callback_state(self, state):
+        self.positions.append(list(state.position))
+
+
+if __name__ == '__main__':
+    import rostest
+    rostest.rosrun('joint_state_publisher', 'test_trajectory_playback', TrajectoryPlaybackTestCase)
@@ -56,6 +56,7 @@ RANGE = 10000
 
 class JointStatePublisherGui(QWidget):
     sliderUpdateTrigger = Signal()
+    reloadTrigger = Signal()
 
     def __init__(self, title, jsp, num_rows=0):
         super(JointStatePublisherGui, self).__init__()
@@ -69,10 +70,47 @@ class JointStatePublisherGui(QWidget):
         self.scroll.setWidgetResizable(True)
 
         self.jsp.set_source_update_cb(self.source_update_cb)
+        self.jsp.set_reload_cb(self.reload_cb)
 
-        font = QFont("Helvetica", 9, QFont.Bold)
+        self.slider_font = QFont("Helvetica", 9, QFont.Bold)
 
         ### Generate sliders ###
+        self.requested_rows = num_rows
+        sliders = self.generate_sliders()
+        self.place_sliders(sliders)
+
+        # Set zero positions read from parameters
+        self.center()
+
+        # Synchronize slider and displayed value
+        self.sliderUpdate(None)
+
+        # Set up a signal for updating the sliders based on external joint info
+        self.sliderUpdateTrigger.connect(self.updateSliders)
+        # And for rebuilding them when the robot description changes
+        self.reloadTrigger.connect(self.rebuildSliders)
+
+        self.scrollable.setLayout(self.gridlayout)
+        self.scroll.setWidget(self.scrollable)
+        self.vlayout.addWidget(self.scroll)
+
+        # Buttons for randomizing and centering sliders and
+        # Spinbox for on-the-fly selecting number of rows
+        self.randbutton = QPushButton('Randomize', self)
+        self.randbutton.clicked.connect(self.randomize_event)
+        self.vlayout.addWidget(self.randbutton)
+        self.ctrbutton = QPushButton('Center', self)
+        self.ctrbutton.clicked.connect(self.center_event)
+        self.vlayout.addWidget(self.ctrbutton)
+        self.maxrowsupdown = QSpinBox()
+        self.maxrowsupdown.setMinimum(1)
+        self.maxrowsupdown.setMaximum(len(sliders))
+        self.maxrowsupdown.setValue(self.num_rows)
+        self.maxrowsupdown.valueChanged.connect(self.reorggrid_event)
+        self.vlayout.addWidget(self.maxrowsupdown)
+        self.setLayout(self.vlayout)
+
+    def generate_sliders(self):
         sliders = []
         for name in self.jsp.joint_list:
             if name not in self.jsp.free_joints:
@@ -86,11 +124,11 @@ class JointStatePublisherGui(QWidget):
             row_layout = QHBoxLayout()
 
             label = QLabel(name)
-            label.setFont(font)
+            label.setFont(self.slider_font)
             row_layout.addWidget(label)
             display = QLineEdit("0.00")
             display.setAlignment(Qt.AlignRight)
-            display.setFont(font)
+            display.setFont(self.slider_font)
             display.setReadOnly(True)
             row_layout.addWidget(display)
 
@@ -98,7 +136,7 @@ class JointStatePublisherGui(QWidget):
 
             slider = QSlider(Qt.Horizontal)
 
-            slider.setFont(font)
+            slider.setFont(self.slider_font)
             slider.setRange(0, RANGE)
             slider.setValue(int(RANGE/2))
 
@@ -110,9 +148,11 @@ class JointStatePublisherGui(QWidget):
             slider.valueChanged.connect(lambda event,name=name: self.onValueChangedOne(name))
 
             sliders.append(joint_layout)
+        return sliders
 
+    def place_sliders(self, sliders):
         # Determine number of rows to be used in grid
-        self.num_rows = num_rows
+        self.num_rows = self.requested_rows
         # if desired num of rows wasn't set, default behaviour is a vertical layout
         if self.num_rows == 0:
             self.num_rows = len(sliders)  # equals VBoxLayout
@@ -121,37 +161,42 @@ class JointStatePublisherGui(QWidget):
         for item, pos in zip(sliders, self.positions):
             self.gridlayout.addLayout(item, *pos)
 
-        # Set zero positions read from parameters
-        self.center()
-
-        # Synchronize slider and displayed value
-        self.sliderUpdate(None)
+    def source_update_cb(self):
+        self.sliderUpdateTrigger.emit()
 
-        # Set up a signal for updating the sliders based on external joint info
-        self.sliderUpdateTrigger.connect(self.updateSliders)
+    def reload_cb(self):
+        self.reloadTrigger.emit()
 
-        self.scrollable.setLayout(self.gridlayout)
-        self.scroll.setWidget(self.scrollable)
-        self.vlayout.addWidget(self.scroll)
+    @pyqtSlot()
+    def rebuildSliders(self):
+        self.rebuild_sliders()
 
-        # Buttons for randomizing and centering sliders and
-        # Spinbox for on-the-fly selecting number of rows
-        self.randbutton = QPushButton('Randomize', self)
-        self.randbutton.clicked.connect(self.randomize_event)
-        self.vlayout.addWidget(self.randbutton)
-        self.ctrbutton = QPushButton('Center', self)
-        self.ctrbutton.clicked.connect(self.center_event)
-        self.vlayout.addWidget(self.ctrbutton)
-        self.maxrowsupdown = QSpinBox()
-        self.maxrowsupdown.setMinimum(1)
+    def rebuild_sliders(self):
+        # The joint_state_publisher switched to a new robot description, so
+        # the sliders refer to joints that are no longer published.  Replace
+        # them with sliders for the new joints, which keep their values.
+        for pos in self.positions:
+            item = self.gridlayout.itemAtPosition(*pos)
+            self.gridlayout.removeItem(item)
+            self.delete_layout(item.layout())
+        self.joint_map = {}
+        sliders = self.generate_sliders()
+        self.place_sliders(sliders)
+        self.maxrowsupdown.blockSignals(True)
         self.maxrowsupdown.setMaximum(len(sliders))
         self.maxrowsupdown.setValue(self.num_rows)
-        self.maxrowsupdown.valueChanged.connect(self.reorggrid_event)
-        self.vlayout.addWidget(self.maxrowsupdown)
-        self.setLayout(self.vlayout)
+        self.maxrowsupdown.blockSignals(False)
+        self.update_sliders()
+        for name, joint_info in self.joint_map.items():
+            joint_info['display'].setText("%.3f" % joint_info['joint']['position'])
 
-    def source_update_cb(self):
-        self.sliderUpdateTrigger.emit()
+    def delete_layout(self, layout):
+        while layout.count():
+            item = layout.takeAt(0)
+            if item.widget() is not None:
+                item.widget().deleteLater()
+            elif item.layout() is not None:
+                self.delete_layout(item.layout())
 
     def onValueChangedOne(self, name):
         # A slider value was changed, but we need to change the joint_info metadata.
@@ -160,6 +205,7 @@ class JointStatePublisherGui(QWidget):
         joint = joint_info['joint']
         joint['position'] = self.sliderToValue(joint_info['slidervalue'], joint)
         joint_info['display'].setText("%.3f" % joint['position'])
+        self.jsp.request_publish()
 
     @pyqtSlot()
     def updateSliders(self):
@@ -182,6 +228,7 @@ class JointStatePublisherGui(QWidget):
             joint_info['slider'].setValue(self.valueToSlider(joint['zero'], joint))
 
     def reorggrid_event(self, event):
+        self.requested_rows = event
         self.reorganize_grid(event)
 
     def reorganize_grid(self, number_of_rows):